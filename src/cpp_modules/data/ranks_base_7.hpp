@@ -1,7 +0,0 @@
-#ifndef RANKS_BASE_7
-#define RANKS_BASE_7
-
-extern const unsigned long long surfaceRanksChunked[5764801];
-// extern const unsigned long long surfaceRanksChunked[5764801] = {};
-
-#endif
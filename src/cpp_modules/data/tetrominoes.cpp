@@ -1,5 +1,4 @@
 #include "../src/types.hpp"
-#include <list>
 
 std::string PIECE_CHAR_LIST = "IOLJTSZ";
 
@@ -151,18 +150,18 @@ const Piece PIECE_Z = { 'Z', 6, {
                },{ 17, 17, NONE, NONE},
                -1 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_I = {
+static const TuckOriginSpot TUCK_SPOTS_I[] = {
   {0, 0, 2},
   {0, 3, 2},
   {1, 2, 0}
 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_O = {
+static const TuckOriginSpot TUCK_SPOTS_O[] = {
   {0, 1, 1},
   {0, 2, 1}
 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_L = {
+static const TuckOriginSpot TUCK_SPOTS_L[] = {
   {0, 1, 1},
   {0, 3, 1},
   {1, 1, 0},
@@ -173,7 +172,7 @@ static std::list<TuckOriginSpot> TUCK_SPOTS_L = {
   {3, 3, 2}
 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_J = {
+static const TuckOriginSpot TUCK_SPOTS_J[] = {
   {0, 1, 1},
   {0, 3, 1},
   {1, 1, 2},
@@ -184,7 +183,7 @@ static std::list<TuckOriginSpot> TUCK_SPOTS_J = {
   {3, 3, 0}
 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_T = {
+static const TuckOriginSpot TUCK_SPOTS_T[] = {
   {0, 1, 1},
   {0, 3, 1},
   {1, 1, 1},
@@ -195,14 +194,14 @@ static std::list<TuckOriginSpot> TUCK_SPOTS_T = {
   {3, 3, 1},
 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_S = {
+static const TuckOriginSpot TUCK_SPOTS_S[] = {
   {0, 1, 2},
   {0, 3, 1},
   {1, 2, 0},
   {1, 3, 1}
 };
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_Z = {
+static const TuckOriginSpot TUCK_SPOTS_Z[] = {
   {0, 1, 1},
   {0, 3, 2},
   {1, 3, 0},
@@ -211,9 +210,28 @@ static std::list<TuckOriginSpot> TUCK_SPOTS_Z = {
 
 const Piece PIECE_LIST[7] = {PIECE_I, PIECE_O, PIECE_L, PIECE_J, PIECE_T, PIECE_S, PIECE_Z};
 
-static std::list<TuckOriginSpot> TUCK_SPOTS_LIST[7] = {TUCK_SPOTS_I, TUCK_SPOTS_O, TUCK_SPOTS_L, TUCK_SPOTS_J, TUCK_SPOTS_T, TUCK_SPOTS_S, TUCK_SPOTS_Z};
+/** A view of one piece's tuck origin spots, so that they can be looked up by piece index. */
+struct TuckOriginSpotList {
+  const TuckOriginSpot *spots;
+  int size;
 
-std::list<TuckInput> TUCK_INPUTS {
+  const TuckOriginSpot *begin() const { return spots; }
+  const TuckOriginSpot *end() const { return spots + size; }
+};
+
+#define TUCK_SPOT_LIST_OF(spots) {spots, (int) (sizeof(spots) / sizeof(TuckOriginSpot))}
+
+static const TuckOriginSpotList TUCK_SPOTS_LIST[7] = {
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_I),
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_O),
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_L),
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_J),
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_T),
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_S),
+  TUCK_SPOT_LIST_OF(TUCK_SPOTS_Z)
+};
+
+const TuckInput TUCK_INPUTS[8] = {
   {'L', -1, 0},
   {'R', 1, 0},
   {'A', 0, 1},
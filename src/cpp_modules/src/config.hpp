@@ -19,6 +19,7 @@
 // How the agent should play
 #define USE_RANKS 0
 #define USE_BASE_7_RANKS 1
+#define DEFAULT_SURFACE_RANKS_PATH "src/cpp_modules/data/ranks_base_7.bin" // Loaded when the module starts. Relative to the working directory.
 #define CAN_TUCK 1
 #define WELL_COLUMN 9
 #define USE_RIGHT_WELL_FEATURES 1
@@ -33,6 +34,8 @@
 #define DEFAULT_PLAYOUT_COUNT 49
 #define DEFAULT_PLAYOUT_LENGTH 2
 #define DEFAULT_PRUNING_BREADTH 20
+#define DEFAULT_MOVE_SEARCH_ENGINE FRAME_SIMULATION // Can be overridden per request (see MoveSearchEngine)
+#define DEFAULT_PLAYOUT_BUDGET FIXED_PLAYOUT_BUDGET // Can be overridden per request (see PlayoutBudget)
 #define TRACK_PLAYOUT_DETAILS true // Can disable for performance reasons
 
 // Logistics of move search and pruning
@@ -40,5 +43,9 @@
 #define SEMI_HOLE_PROPORTION 0.6f // Value used for things that are sort of like holes but not fully, e.g. unfilled wells while digging
 #define SEQUENCE_LENGTH 20
 #define EXHAUSTIVE_SEQUENCE_LENGTH 4
+#define NUM_CANONICAL_SEQUENCES_PER_PIECE 1000 // How many of the randomly-generated sequences start after each piece
+#define USE_MOVE_SEARCH_CACHE 1 // Reuse the placements found on boards that have already been searched (common in playouts)
+#define USE_EVAL_CACHE 1 // Reuse the evals of boards that have already been evaluated in the same context (also common in playouts)
+#define USE_SIMD_SURFACE_KERNELS 1 // Use SSE4.1/AVX2 for the surface features when the CPU supports them (picked at runtime, x86 only)
 
 #endif
@@ -3,11 +3,32 @@
 #include "eval_context.hpp"
 #include "utils.hpp"
 #include "../data/ranks_output.hpp"
-#include "../data/ranks_base_7.hpp"
+#include "surface_ranks.hpp"
+#include "move_search.hpp"
+#include "piece_ranges.hpp"
+#include <atomic>
+#include <chrono>
+#include <limits.h>
 #include <math.h>
+#include <string>
 #include <vector>
 using namespace std;
 
+#if USE_SIMD_SURFACE_KERNELS && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAS_X86_SURFACE_KERNELS 1
+#else
+#define HAS_X86_SURFACE_KERNELS 0
+#endif
+
+/** Precomputed pow(diff, 1.5) for every possible column diff, since that's used for each diff of each surface rated. */
+const double DIFF_PENALTIES[21] = {
+  0.0, 1.0, 2.8284271247461903, 5.196152422706632, 8.0, 11.180339887498949, 14.696938456699069,
+  18.520259177452136, 22.627416997969522, 27.0, 31.622776601683793, 36.4828726939094, 41.569219381653056,
+  46.87216658103186, 52.38320341483518, 58.09475019311125, 64.0, 70.09279563550022, 76.36753236814714,
+  82.8190799272728, 89.44271909999159
+};
+
 /**
  * A crude way to evaluate a surface for when I'm debugging and don't want to load the surfaces every time I
  * run.
@@ -29,7 +50,7 @@ float calculateFlatness(int surfaceArray[10], int wellColumn) {
     }
     // Punish based on the absolute value of the column differences
     if (diff != 0) {
-      score -= pow(abs(diff), 1.5);
+      score -= DIFF_PENALTIES[abs(diff)];
     }
     // Line dependency
     if (diff >= 3 && (i == 0 || (surfaceArray[i] - surfaceArray[i-1]) <= -3)) {
@@ -43,30 +64,206 @@ float calculateFlatness(int surfaceArray[10], int wellColumn) {
   return score;
 }
 
+/** The value of each digit of the base-7 surface encoding. */
+const int SURFACE_RANK_PLACE_VALUES[8] = {823543, 117649, 16807, 2401, 343, 49, 7, 1};
+
+/**
+ * Encodes the diff between column i and the next one as a digit of the custom base-7 encoding.
+ * Also finds the part of the diff that's beyond the +/- 3 range of the encoding.
+ */
+int getSurfaceRankDigit(int surfaceArray[10], int i, int wellColumn, OUT int &excessGap) {
+  int diff = surfaceArray[i + 1] - surfaceArray[i];
+  excessGap = 0;
+  // Correct for double wells
+  if (i == 7 && wellColumn == 9 && diff < -2) {
+    diff = -2;
+  } else if (abs(diff) > 3) {
+    excessGap = abs(diff) - 3;
+    diff = diff > 0 ? 3 : -3;
+  }
+  return diff + 3;
+}
+
+/** How far the highest column in a range sticks up above the accessible surface (or 0 if none do). */
+int getHeightAboveAccessible(int surfaceArray[10], int const maxAccessibleSurface[10], int startCol, int endCol) {
+  int highestAbove = 0;
+  for (int i = startCol; i < endCol; i++) {
+    if (surfaceArray[i] > maxAccessibleSurface[i]) {
+      highestAbove = std::max(highestAbove, surfaceArray[i] - maxAccessibleSurface[i]);
+    }
+  }
+  return highestAbove;
+}
+
+SurfaceFeatures getSurfaceFeaturesScalar(int surfaceArray[10], const EvalContext *evalContext) {
+  SurfaceFeatures features = {};
+  for (int i = 0; i < 8; i++) {
+    features.rankDigits[i] = getSurfaceRankDigit(surfaceArray, i, evalContext->wellColumn, features.rankExcessGaps[i]);
+    features.rankIndex = features.rankIndex * 7 + features.rankDigits[i];
+    features.excessGap += features.rankExcessGaps[i];
+  }
+  // Col 7 is the furthest right a 5 tap piece is on the board when tapped left
+  features.leftHeightAboveAccessible = getHeightAboveAccessible(surfaceArray, evalContext->pieceRangeContext.maxAccessibleLeft5Surface, 0, 7);
+  features.rightHeightAboveAccessible = getHeightAboveAccessible(surfaceArray, evalContext->pieceRangeContext.maxAccessibleRightSurface, 5, 10);
+  return features;
+}
+
+/* ----------- SIMD SURFACE KERNELS ----------- */
+// Versions of getSurfaceFeaturesScalar that work on all the column diffs at once. They're compiled for their instruction
+// set regardless of the build flags, and only called if the CPU running the engine supports it (see getSurfaceFeatures).
+
+#if HAS_X86_SURFACE_KERNELS
+
+__attribute__((target("sse4.1")))
+int sumLanes(__m128i v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse4.1")))
+int maxLanes(__m128i v) {
+  v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+/**
+ * Encodes 4 column diffs as digits of the base-7 surface encoding (see getSurfaceRankDigit).
+ * The lower bounds are applied before the encoding, for correcting double wells.
+ */
+__attribute__((target("sse4.1")))
+void getSurfaceRankDigitsSse4(__m128i diffs, __m128i lowerBounds, OUT __m128i &digits, OUT __m128i &excessGaps) {
+  __m128i three = _mm_set1_epi32(3);
+  diffs = _mm_max_epi32(diffs, lowerBounds);
+  digits = _mm_add_epi32(_mm_min_epi32(_mm_max_epi32(diffs, _mm_set1_epi32(-3)), three), three);
+  excessGaps = _mm_max_epi32(_mm_sub_epi32(_mm_abs_epi32(diffs), three), _mm_setzero_si128());
+}
+
+__attribute__((target("sse4.1")))
+SurfaceFeatures getSurfaceFeaturesSse4(int surfaceArray[10], const EvalContext *evalContext) {
+  SurfaceFeatures features;
+  __m128i noBound = _mm_set1_epi32(INT_MIN);
+  __m128i lastDiffBound = evalContext->wellColumn == 9 ? _mm_setr_epi32(INT_MIN, INT_MIN, INT_MIN, -2) : noBound;
+
+  __m128i digitsLo, digitsHi, excessGapsLo, excessGapsHi;
+  __m128i colsLo = _mm_loadu_si128((__m128i const *) &surfaceArray[0]);
+  __m128i colsHi = _mm_loadu_si128((__m128i const *) &surfaceArray[4]);
+  getSurfaceRankDigitsSse4(_mm_sub_epi32(_mm_loadu_si128((__m128i const *) &surfaceArray[1]), colsLo), noBound, digitsLo, excessGapsLo);
+  getSurfaceRankDigitsSse4(_mm_sub_epi32(_mm_loadu_si128((__m128i const *) &surfaceArray[5]), colsHi), lastDiffBound, digitsHi, excessGapsHi);
+  _mm_storeu_si128((__m128i *) &features.rankDigits[0], digitsLo);
+  _mm_storeu_si128((__m128i *) &features.rankDigits[4], digitsHi);
+  _mm_storeu_si128((__m128i *) &features.rankExcessGaps[0], excessGapsLo);
+  _mm_storeu_si128((__m128i *) &features.rankExcessGaps[4], excessGapsHi);
+  features.rankIndex = sumLanes(_mm_add_epi32(
+    _mm_mullo_epi32(digitsLo, _mm_loadu_si128((__m128i const *) &SURFACE_RANK_PLACE_VALUES[0])),
+    _mm_mullo_epi32(digitsHi, _mm_loadu_si128((__m128i const *) &SURFACE_RANK_PLACE_VALUES[4]))));
+  features.excessGap = sumLanes(_mm_add_epi32(excessGapsLo, excessGapsHi));
+
+  // Same ranges as getSurfaceFeaturesScalar, i.e. cols 0-6 on the left and 5-9 on the right
+  PieceRangeContext const &ranges = evalContext->pieceRangeContext;
+  __m128i leftAbove = _mm_max_epi32(
+    _mm_sub_epi32(colsLo, _mm_loadu_si128((__m128i const *) &ranges.maxAccessibleLeft5Surface[0])),
+    _mm_sub_epi32(_mm_loadu_si128((__m128i const *) &surfaceArray[3]), _mm_loadu_si128((__m128i const *) &ranges.maxAccessibleLeft5Surface[3])));
+  __m128i rightAbove = _mm_max_epi32(
+    _mm_sub_epi32(_mm_loadu_si128((__m128i const *) &surfaceArray[5]), _mm_loadu_si128((__m128i const *) &ranges.maxAccessibleRightSurface[5])),
+    _mm_sub_epi32(_mm_loadu_si128((__m128i const *) &surfaceArray[6]), _mm_loadu_si128((__m128i const *) &ranges.maxAccessibleRightSurface[6])));
+  features.leftHeightAboveAccessible = max(0, maxLanes(leftAbove));
+  features.rightHeightAboveAccessible = max(0, maxLanes(rightAbove));
+  return features;
+}
+
+__attribute__((target("avx2")))
+SurfaceFeatures getSurfaceFeaturesAvx2(int surfaceArray[10], const EvalContext *evalContext) {
+  SurfaceFeatures features;
+  // The 8 diffs that make up the encoding fit in a single register
+  __m256i three = _mm256_set1_epi32(3);
+  __m256i cols = _mm256_loadu_si256((__m256i const *) &surfaceArray[0]);
+  __m256i diffs = _mm256_sub_epi32(_mm256_loadu_si256((__m256i const *) &surfaceArray[1]), cols);
+  if (evalContext->wellColumn == 9) {
+    // Correct for double wells
+    diffs = _mm256_max_epi32(diffs, _mm256_setr_epi32(INT_MIN, INT_MIN, INT_MIN, INT_MIN, INT_MIN, INT_MIN, INT_MIN, -2));
+  }
+  __m256i digits = _mm256_add_epi32(_mm256_min_epi32(_mm256_max_epi32(diffs, _mm256_set1_epi32(-3)), three), three);
+  __m256i excessGaps = _mm256_max_epi32(_mm256_sub_epi32(_mm256_abs_epi32(diffs), three), _mm256_setzero_si256());
+  _mm256_storeu_si256((__m256i *) features.rankDigits, digits);
+  _mm256_storeu_si256((__m256i *) features.rankExcessGaps, excessGaps);
+  __m256i placeValues = _mm256_loadu_si256((__m256i const *) SURFACE_RANK_PLACE_VALUES);
+  __m256i weightedDigits = _mm256_mullo_epi32(digits, placeValues);
+  features.rankIndex = sumLanes(_mm_add_epi32(_mm256_castsi256_si128(weightedDigits), _mm256_extracti128_si256(weightedDigits, 1)));
+  features.excessGap = sumLanes(_mm_add_epi32(_mm256_castsi256_si128(excessGaps), _mm256_extracti128_si256(excessGaps, 1)));
+
+  // Cols 0-6 on the left (col 7 is masked off) and cols 5-9 on the right (cols 2-4 are masked off)
+  PieceRangeContext const &ranges = evalContext->pieceRangeContext;
+  __m256i leftAbove = _mm256_sub_epi32(cols, _mm256_loadu_si256((__m256i const *) ranges.maxAccessibleLeft5Surface));
+  leftAbove = _mm256_blend_epi32(leftAbove, _mm256_setzero_si256(), 0x80);
+  __m256i rightAbove = _mm256_sub_epi32(_mm256_loadu_si256((__m256i const *) &surfaceArray[2]),
+                                        _mm256_loadu_si256((__m256i const *) &ranges.maxAccessibleRightSurface[2]));
+  rightAbove = _mm256_blend_epi32(rightAbove, _mm256_setzero_si256(), 0x07);
+  features.leftHeightAboveAccessible = max(0, maxLanes(_mm_max_epi32(_mm256_castsi256_si128(leftAbove), _mm256_extracti128_si256(leftAbove, 1))));
+  features.rightHeightAboveAccessible = max(0, maxLanes(_mm_max_epi32(_mm256_castsi256_si128(rightAbove), _mm256_extracti128_si256(rightAbove, 1))));
+  return features;
+}
+
+#endif
+
+typedef SurfaceFeatures (*SurfaceFeaturesKernel)(int surfaceArray[10], const EvalContext *evalContext);
+
+/** Picks the fastest surface features kernel that the CPU supports. */
+SurfaceFeaturesKernel pickSurfaceFeaturesKernel() {
+#if HAS_X86_SURFACE_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return getSurfaceFeaturesAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return getSurfaceFeaturesSse4;
+  }
+#endif
+  return getSurfaceFeaturesScalar;
+}
+
+const SurfaceFeaturesKernel surfaceFeaturesKernel = pickSurfaceFeaturesKernel();
+
+SurfaceFeatures getSurfaceFeatures(int surfaceArray[10], const EvalContext *evalContext) {
+  return surfaceFeaturesKernel(surfaceArray, evalContext);
+}
+
+/**
+ * Gets the surface features of a board from those of its parent, when the columns from startCol to endCol (exclusive)
+ * are the only ones that changed. The change must not have cleared any lines, so that no column got lower.
+ */
+SurfaceFeatures updateSurfaceFeatures(SurfaceFeatures const &parentFeatures,
+                                      int surfaceArray[10],
+                                      int startCol,
+                                      int endCol,
+                                      const EvalContext *evalContext) {
+  SurfaceFeatures features = parentFeatures;
+  // A column's height shows up in the diffs on either side of it
+  for (int i = max(0, startCol - 1); i < min(8, endCol); i++) {
+    int oldDigit = features.rankDigits[i];
+    features.excessGap -= features.rankExcessGaps[i];
+    features.rankDigits[i] = getSurfaceRankDigit(surfaceArray, i, evalContext->wellColumn, features.rankExcessGaps[i]);
+    features.rankIndex += (features.rankDigits[i] - oldDigit) * SURFACE_RANK_PLACE_VALUES[i];
+    features.excessGap += features.rankExcessGaps[i];
+  }
+  // Columns only got higher, so the highest point above the accessible surface can only have moved into the changed columns
+  features.leftHeightAboveAccessible = max(features.leftHeightAboveAccessible,
+                                           getHeightAboveAccessible(surfaceArray, evalContext->pieceRangeContext.maxAccessibleLeft5Surface, max(0, startCol), min(7, endCol)));
+  features.rightHeightAboveAccessible = max(features.rightHeightAboveAccessible,
+                                            getHeightAboveAccessible(surfaceArray, evalContext->pieceRangeContext.maxAccessibleRightSurface, max(5, startCol), min(10, endCol)));
+  return features;
+}
+
 /** Gets the value of a surface. */
-float rateSurface(int surfaceArray[10], const EvalContext *evalContext) {
+float rateSurface(int surfaceArray[10], SurfaceFeatures const &surfaceFeatures, const EvalContext *evalContext) {
   int wellColumn = evalContext->wellColumn;
   
-  if (USE_BASE_7_RANKS){
-    // Convert the surface array into the custom base-9 encoding
-    int b7index = 0;
-    int excessGap = 0;
-    for (int i = 0; i < 8; i++) {
-      int diff = surfaceArray[i + 1] - surfaceArray[i];
-      // Correct for double wells
-      if (i == 7 && wellColumn == 9 && diff < -2) {
-        diff = -2;
-      } else if (abs(diff) > 3) {
-        excessGap += abs(diff) - 3;
-        diff = diff > 0 ? 3 : -3;
-      }
-      b7index *= 7;
-      b7index += diff + 3;
-    }
-    unsigned long long chunk = surfaceRanksChunked[b7index / 8];
-    unsigned int subIndex = b7index & 0b111;
-    int numShifts = (7 - subIndex) * 8;
-    unsigned int byte = (chunk >> numShifts) & 0xFF;
+  if (USE_BASE_7_RANKS && surfaceRanks != NULL){
+    // Look up the surface by its custom base-7 encoding
+    int b7index = surfaceFeatures.rankIndex;
+    int excessGap = surfaceFeatures.excessGap;
+    unsigned int byte = surfaceRanks[b7index];
     float scaledTo30 = ((float) byte) / 255.0 * 33.8;
     // Make lower ranks more punishing
     float rawScore = scaledTo30 + (excessGap * evalContext->weights.extremeGapCoef);
@@ -77,6 +274,35 @@ float rateSurface(int surfaceArray[10], const EvalContext *evalContext) {
   return calculateFlatness(surfaceArray, wellColumn);
 }
 
+/**
+ * The raw board features that the eval factors share, collected in a single pass over the rows.
+ * (Factors that only need a few specific rows, such as the tetris-ready rows, look those up directly.)
+ */
+struct BoardFeatures {
+  int guaranteedBurns; // Rows that have a filled cell in the well or need to be cleared to uncover a hole
+  int holeWeight; // Rows that need to be cleared to uncover a hole
+  int col1Cells; // Filled cells in the leftmost column
+  unsigned int allRowBits; // The union of every row, for checking which columns have holes
+};
+
+BoardFeatures getBoardFeatures(unsigned int board[20], int wellColumn) {
+  unsigned int wellMask = wellColumn >= 0 ? CELL_BIT(wellColumn) : 0;
+  int guaranteedBurns = 0;
+  int holeWeight = 0;
+  int col1Cells = 0;
+  unsigned int allRowBits = 0;
+  // Kept free of branches so that it can be vectorized
+  for (int r = 0; r < 20; r++) {
+    unsigned int row = board[r];
+    unsigned int rowHasHoleWeight = row >> 30;
+    guaranteedBurns += ((row & wellMask) != 0) | rowHasHoleWeight;
+    holeWeight += rowHasHoleWeight;
+    col1Cells += (row >> 9) & 1;
+    allRowBits |= row;
+  }
+  return {guaranteedBurns, holeWeight, col1Cells, allRowBits};
+}
+
 float getAverageHeight(int surfaceArray[10], int wellColumn) {
   float avgHeight = 0;
   float weight = wellColumn >= 0 ? 0.1 : 0.111111;
@@ -94,7 +320,7 @@ float getAverageHeightFactor(int avgHeight, float scareHeight) {
   return diff * diff;
 }
 
-float getBuiltOutLeftFactor(int surfaceArray[10], unsigned int board[20], float avgHeight, float scareHeight) {
+float getBuiltOutLeftFactor(int surfaceArray[10], BoardFeatures const &features, float avgHeight, float scareHeight) {
   if (!USE_RIGHT_WELL_FEATURES) {
     return 0;
   }
@@ -106,24 +332,19 @@ float getBuiltOutLeftFactor(int surfaceArray[10], unsigned int board[20], float
     float softenedHeightRatio = 0.5f * (heightRatio + 1); // Average it with 1 to make it less extreme (faster than sqrt operation)
     return -0.5 * heightDiff * heightDiff * softenedHeightRatio; // Approximate (heightDiff ^ 1.5) as (heightDiff * heightDiff * 0.5)
   }
-  // Check for holes (don't reward building out the left over holes)
-  int r = 21 - surfaceArray[0];
-  while (r < 20) {
-    if (!(board[r] & (1 << 9))) {
-      return 0;
-    }
-    r++;
+  // Check for holes (don't reward building out the left over holes), i.e. every cell under the surface is filled
+  if (features.col1Cells != surfaceArray[0]) {
+    return 0;
   }
   // Reward built out left
   return heightRatio * heightDiff;
 }
 
-float getLeftSurfaceFactor(unsigned int board[20], int surfaceArray[10], int max5TapHeight){
+float getLeftSurfaceFactor(BoardFeatures const &features, int surfaceArray[10], int max5TapHeight){
   max5TapHeight = max(0, max5TapHeight);
-  for (int r = 20 - surfaceArray[0]; r < 20; r++) {
-    if (board[r] & HOLE_BIT(0)) {
-      return -5;
-    }
+  // Holes are only ever marked under the surface
+  if (features.allRowBits & HOLE_BIT(0)) {
+    return -5;
   }
   if (surfaceArray[1] > max5TapHeight && surfaceArray[1] > surfaceArray[0]) {
     return surfaceArray[0] - surfaceArray[1];
@@ -142,48 +363,31 @@ float getCol9Factor(int col9Height, float maxSafeCol9Height){
   return diff * diff;
 }
 
-float getCoveredWellFactor(unsigned int board[20], int wellColumn, float scareHeight) {
-  if (wellColumn == -1) {
+float getCoveredWellFactor(unsigned int board[20], int surfaceArray[10], int wellColumn, float scareHeight) {
+  if (wellColumn == -1 || surfaceArray[wellColumn] == 0) {
     return 0;
   }
-  int mask = (1 << (9 - wellColumn));
-  for (int r = 0; r < 20; r++) {
-    if (board[r] & mask) {
-      int difficultyMultiplier = (board[r] & (ALL_TUCK_SETUP_BITS)) > 0 ? 10 : 1;
-      float heightRatio = (20.0f - r) / max(3.0f, scareHeight);
-      return heightRatio * heightRatio * heightRatio * difficultyMultiplier;
-    }
-  }
-  return 0;
+  // The highest filled cell in the well is at the well's surface
+  int r = 20 - surfaceArray[wellColumn];
+  int difficultyMultiplier = (board[r] & (ALL_TUCK_SETUP_BITS)) > 0 ? 10 : 1;
+  float heightRatio = (20.0f - r) / max(3.0f, scareHeight);
+  return heightRatio * heightRatio * heightRatio * difficultyMultiplier;
 }
 
-float getGuaranteedBurnsFactor(unsigned int board[20], int wellColumn) {
+float getGuaranteedBurnsFactor(BoardFeatures const &features, int wellColumn) {
   // Neither of these measures make sense in lineout mode, so don't calculate this factor
   if (wellColumn == -1) {
     return 0;
   }
-  int wellMask = (1 << (9 - wellColumn));
-  int guaranteedBurns = 0;
-  for (int r = 0; r < 20; r++) {
-    if ((board[r] & wellMask) || (board[r] & HOLE_WEIGHT_BIT)) {
-      guaranteedBurns++;
-    }
-  }
-  return guaranteedBurns;
+  return features.guaranteedBurns;
 }
 
-float getHoleWeightFactor(unsigned int board[20], int wellColumn) {
+float getHoleWeightFactor(BoardFeatures const &features, int wellColumn) {
   // Neither of these measures make sense in lineout mode, so don't calculate this factor
   if (wellColumn == -1) {
     return 0;
   }
-  int holeWeight = 0;
-  for (int r = 0; r < 20; r++) {
-    if ((board[r] & HOLE_WEIGHT_BIT)) {
-      holeWeight++;
-    }
-  }
-  return holeWeight;
+  return features.holeWeight;
 }
 
 
@@ -209,7 +413,7 @@ float getLikelyBurnsFactor(int surfaceArray[10], int wellColumn, int maxSafeCol9
  * Assesses whether the surface allows for 5 taps.
  * @returns the multiple of the accessible left penalty that should be applied. That is, 0 if 5 taps are possible, or a float around 1.0 or higher (depending on how many lines would need to clear for the left to be accessible).
  */
-float getInaccessibleLeftFactor(unsigned int board[20], int surfaceArray[10], int const maxAccessibleLeftSurface[10], int wellColumn){
+float getInaccessibleLeftFactor(unsigned int board[20], int surfaceArray[10], int const maxAccessibleLeftSurface[10], int highestAbove, int wellColumn){
   // Check if the agent even needs to get a piece left first.
   int highestRowOfCol1 = 19 - surfaceArray[0];
   int needs5TapForDig = board[highestRowOfCol1] & HOLE_WEIGHT_BIT;
@@ -230,30 +434,16 @@ float getInaccessibleLeftFactor(unsigned int board[20], int surfaceArray[10], in
   if (surfaceArray[0] > maxAccessibleLeftSurface[0] && surfaceArray[0] >= surfaceArray[1] && !needs5Tap && !hasHoleInLeft) {
     return 0;
   }
-
-  int highestAbove = 0;
-  for (int i = 0; i < 7; i++) {  // col 7 is the furthest right a 5 tap piece is on the board when tapped left
-    if (surfaceArray[i] > maxAccessibleLeftSurface[i]) {
-      highestAbove = std::max(highestAbove, surfaceArray[i] - maxAccessibleLeftSurface[i]);
-    }
-  }
   return highestAbove == 0 ? 0 : (1.0 + 0.2 * highestAbove * highestAbove);
 }
 
-float getInaccessibleRightFactor(int surfaceArray[10], int const maxAccessibleRightSurface[10]){
+float getInaccessibleRightFactor(int surfaceArray[10], int const maxAccessibleRightSurface[10], int highestAbove){
   // Check if the agent even needs to get a piece right first.
   // If column 10 is higher than column 9, this feature doesn't matter.
   int needsRightTap = surfaceArray[9] < surfaceArray[8];
   if (surfaceArray[9] > maxAccessibleRightSurface[9] && !needsRightTap) {
     return 0;
   }
-
-  int highestAbove = 0;
-  for (int i = 5; i < 10; i++) {  // col 7 is the furthest right a 5 tap piece is on the board when tapped left
-    if (surfaceArray[i] > maxAccessibleRightSurface[i]) {
-      highestAbove = std::max(highestAbove, surfaceArray[i] - maxAccessibleRightSurface[i]);
-    }
-  }
   return highestAbove == 0 ? 0 : 1.0 + 0.2 * highestAbove * highestAbove;
 }
 
@@ -273,7 +463,7 @@ float getUnableToBurnFactor(unsigned int board[20], int surfaceArray[10], float
 
   // If col 10 is also filled, having col 9 filled isn't bad
   if (col9Height <= surfaceArray[9]) {
-    while (board[20 - col9Height] & 1) {
+    while (col9Height > 0 && (board[20 - col9Height] & 1)) {
       col9Height--;
     }
   }
@@ -355,7 +545,7 @@ float rateSurfaceForPerfectPlay(int surfaceArray[10], int wellColumn) {
       score += 20;
     } else if (diff != 0) {
       // Otherwise, punish based on the absolute value of the column differences
-      score += pow(abs(diff), 1.5);
+      score += DIFF_PENALTIES[abs(diff)];
     }
   }
   return score;
@@ -425,38 +615,37 @@ float evalForPerfectPlay(GameState gameState,
 
 
 
-float fastEval(GameState gameState,
-               GameState newState,
-               LockPlacement lockPlacement,
-               const EvalContext *evalContext) {
-  if (SHOULD_PLAY_PERFECT) {
-    return evalForPerfectPlay(gameState, newState, lockPlacement, evalContext);
-  }
-
+/** Evaluates a state whose surface features have already been found, either from scratch or from its parent's. */
+float fastEvalWithSurfaceFeatures(GameState gameState,
+                                  GameState newState,
+                                  LockPlacement lockPlacement,
+                                  SurfaceFeatures const &surfaceFeatures,
+                                  const EvalContext *evalContext) {
   FastEvalWeights weights = evalContext->weights;
   // Preliminary helper work
+  BoardFeatures features = getBoardFeatures(newState.board, evalContext->wellColumn);
   float avgHeight = getAverageHeight(newState.surfaceArray, evalContext->wellColumn);
   int isKillscreenLineout = gameState.level >= 29 && evalContext->aiMode == LINEOUT;
   // Calculate all the factors
   float avgHeightFactor = weights.avgHeightCoef * getAverageHeightFactor(avgHeight, evalContext->scareHeight);
-  float builtOutLeftFactor = weights.builtOutLeftCoef * getBuiltOutLeftFactor(newState.surfaceArray, newState.board, avgHeight, evalContext->scareHeight);
-  float coveredWellFactor = weights.coveredWellCoef * getCoveredWellFactor(newState.board, evalContext->wellColumn, evalContext->scareHeight);
-  float guaranteedBurnsFactor = weights.burnCoef * getGuaranteedBurnsFactor(newState.board, evalContext->wellColumn);
+  float builtOutLeftFactor = weights.builtOutLeftCoef * getBuiltOutLeftFactor(newState.surfaceArray, features, avgHeight, evalContext->scareHeight);
+  float coveredWellFactor = weights.coveredWellCoef * getCoveredWellFactor(newState.board, newState.surfaceArray, evalContext->wellColumn, evalContext->scareHeight);
+  float guaranteedBurnsFactor = weights.burnCoef * getGuaranteedBurnsFactor(features, evalContext->wellColumn);
   float likelyBurnsFactor = weights.burnCoef * getLikelyBurnsFactor(newState.surfaceArray, evalContext->wellColumn, evalContext->maxSafeCol9);
   float highCol9Factor = weights.col9Coef * getCol9Factor(newState.surfaceArray[8], evalContext->maxSafeCol9);
   float holeFactor = weights.holeCoef * (newState.numTrueHoles + newState.numPartialHoles);
-  float holeWeightFactor = abs(weights.holeWeightCoef) > FLOAT_EPSILON ? weights.holeWeightCoef * getHoleWeightFactor(newState.board, evalContext->wellColumn) : 0;
+  float holeWeightFactor = abs(weights.holeWeightCoef) > FLOAT_EPSILON ? weights.holeWeightCoef * getHoleWeightFactor(features, evalContext->wellColumn) : 0;
   float inaccessibleLeftFactor = isKillscreenLineout
               ? 0
-              : (weights.inaccessibleLeftCoef * getInaccessibleLeftFactor(newState.board, newState.surfaceArray, evalContext->pieceRangeContext.maxAccessibleLeft5Surface, evalContext->wellColumn));
+              : (weights.inaccessibleLeftCoef * getInaccessibleLeftFactor(newState.board, newState.surfaceArray, evalContext->pieceRangeContext.maxAccessibleLeft5Surface, surfaceFeatures.leftHeightAboveAccessible, evalContext->wellColumn));
   float inaccessibleRightFactor = isKillscreenLineout
               ? 0
-              : (weights.inaccessibleRightCoef * getInaccessibleRightFactor(newState.surfaceArray, evalContext->pieceRangeContext.maxAccessibleRightSurface));
+              : (weights.inaccessibleRightCoef * getInaccessibleRightFactor(newState.surfaceArray, evalContext->pieceRangeContext.maxAccessibleRightSurface, surfaceFeatures.rightHeightAboveAccessible));
   float lineClearFactor = getLineClearFactor(newState.lines - gameState.lines, weights, evalContext->shouldRewardLineClears);
-  float surfaceFactor = weights.surfaceCoef * rateSurface(newState.surfaceArray, evalContext);
+  float surfaceFactor = weights.surfaceCoef * rateSurface(newState.surfaceArray, surfaceFeatures, evalContext);
   float surfaceLeftFactor =
     (isKillscreenLineout)
-      ? weights.surfaceLeftCoef * getLeftSurfaceFactor(newState.board, newState.surfaceArray, evalContext->pieceRangeContext.max5TapHeight)
+      ? weights.surfaceLeftCoef * getLeftSurfaceFactor(features, newState.surfaceArray, evalContext->pieceRangeContext.max5TapHeight)
       : 0;
   float tetrisReadyFactor =
     (evalContext->wellColumn >= 0 && isTetrisReady(newState.board, newState.surfaceArray, evalContext->wellColumn))
@@ -514,3 +703,464 @@ float fastEval(GameState gameState,
 
   return total;
 }
+
+/**
+ * A direct-mapped cache of eval results, keyed on everything the eval reads.
+ * The board (incl. the auxiliary bits) is stored in full, so only a collision of the context keys could return the
+ * wrong value. The surface isn't stored since it follows from the board.
+ */
+struct EvalCacheEntry {
+  bool isValid;
+  unsigned long long evalContextKey;
+  unsigned int board[20];
+  int numTrueHoles;
+  float numPartialHoles;
+  int lines;
+  int prevLines; // The lines before the placement, for the line clear reward
+  int prevLevel; // The level before the placement, which decides if it's a killscreen lineout
+  float evalScore;
+};
+
+#define EVAL_CACHE_SIZE 4096 // Must be a power of 2
+
+// Each thread gets its own table, so lookups never need to lock
+thread_local EvalCacheEntry evalCache[EVAL_CACHE_SIZE];
+std::atomic<long long> evalCacheHits(0);
+std::atomic<long long> evalCacheMisses(0);
+
+/** Row multipliers for hashing a board. Unlike a chained hash, the multiplications don't depend on each other. */
+const unsigned long long BOARD_HASH_MULTIPLIERS[10] = {
+  0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL, 0xFF51AFD7ED558CCDULL,
+  0xC4CEB9FE1A85EC53ULL, 0x85EBCA77C2B2AE63ULL, 0x27D4EB2F165667C5ULL, 0x94D049BB133111EBULL, 0xBF58476D1CE4E5B9ULL,
+};
+
+unsigned int getEvalCacheIndex(GameState const &gameState, GameState const &newState, const EvalContext *evalContext) {
+  unsigned long long hash = evalContext->evalCacheKey;
+  for (int i = 0; i < 10; i++) {
+    unsigned long long twoRows = ((unsigned long long) newState.board[2 * i] << 32) | newState.board[2 * i + 1];
+    hash += twoRows * BOARD_HASH_MULTIPLIERS[i];
+  }
+  hash += (unsigned long long) ((newState.lines << 16) ^ (gameState.lines << 8) ^ gameState.level) * BOARD_HASH_MULTIPLIERS[0];
+  hash ^= hash >> 31;
+  hash *= BOARD_HASH_MULTIPLIERS[1];
+  return (unsigned int) (hash >> 40) & (EVAL_CACHE_SIZE - 1);
+}
+
+bool isEvalCacheMatch(EvalCacheEntry const &entry, GameState const &gameState, GameState const &newState, const EvalContext *evalContext) {
+  if (!entry.isValid || entry.evalContextKey != evalContext->evalCacheKey || entry.lines != newState.lines
+      || entry.prevLines != gameState.lines || entry.prevLevel != gameState.level || entry.numTrueHoles != newState.numTrueHoles
+      || entry.numPartialHoles != newState.numPartialHoles) {
+    return false;
+  }
+  for (int i = 0; i < 20; i++) {
+    if (entry.board[i] != newState.board[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Finds the cache slot for an eval.
+ * @returns whether the slot already holds this eval's result
+ */
+bool lookUpEvalCache(GameState const &gameState, GameState const &newState, const EvalContext *evalContext, OUT EvalCacheEntry *&entry) {
+  entry = &evalCache[getEvalCacheIndex(gameState, newState, evalContext)];
+  if (!isEvalCacheMatch(*entry, gameState, newState, evalContext)) {
+    evalCacheMisses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  evalCacheHits.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void storeInEvalCache(EvalCacheEntry &entry, GameState const &gameState, GameState const &newState, const EvalContext *evalContext, float evalScore) {
+  // Overwrite whatever was in this slot
+  entry.isValid = true;
+  entry.evalContextKey = evalContext->evalCacheKey;
+  for (int i = 0; i < 20; i++) {
+    entry.board[i] = newState.board[i];
+  }
+  entry.numTrueHoles = newState.numTrueHoles;
+  entry.numPartialHoles = newState.numPartialHoles;
+  entry.lines = newState.lines;
+  entry.prevLines = gameState.lines;
+  entry.prevLevel = gameState.level;
+  entry.evalScore = evalScore;
+}
+
+/** Formats the eval cache counters as JSON, for the binding to report. */
+std::string getEvalCacheStats() {
+  long long hits = evalCacheHits.load(std::memory_order_relaxed);
+  long long misses = evalCacheMisses.load(std::memory_order_relaxed);
+  char buffer[100];
+  snprintf(buffer, 100, "{\"hits\":%lld,\"misses\":%lld}", hits, misses);
+  return std::string(buffer);
+}
+
+/** Whether evals should go through the cache. Skipped while logging, so that every eval prints its breakdown. */
+bool shouldUseEvalCache() {
+  return USE_EVAL_CACHE && !LOGGING_ENABLED && !SHOULD_PLAY_PERFECT;
+}
+
+float fastEval(GameState gameState,
+               GameState newState,
+               LockPlacement lockPlacement,
+               const EvalContext *evalContext) {
+  if (SHOULD_PLAY_PERFECT) {
+    return evalForPerfectPlay(gameState, newState, lockPlacement, evalContext);
+  }
+  EvalCacheEntry *cacheEntry = NULL;
+  if (shouldUseEvalCache() && lookUpEvalCache(gameState, newState, evalContext, cacheEntry)) {
+    return cacheEntry->evalScore;
+  }
+  SurfaceFeatures surfaceFeatures = getSurfaceFeatures(newState.surfaceArray, evalContext);
+  float evalScore = fastEvalWithSurfaceFeatures(gameState, newState, lockPlacement, surfaceFeatures, evalContext);
+  if (cacheEntry != NULL) {
+    storeInEvalCache(*cacheEntry, gameState, newState, evalContext, evalScore);
+  }
+  return evalScore;
+}
+
+/** The most that a factor can add to the eval, given the range of values the factor itself can take. */
+float getMaxFactorValue(float coef, float minFactor, float maxFactor) {
+  return max(coef * minFactor, coef * maxFactor);
+}
+
+/**
+ * An upper bound on what fastEval can return in a given context, found from the most each factor can be worth on a
+ * 20-row board. It's far from tight, but it lets the playouts rule out candidates without playing them (see
+ * getPlayoutScoresPruned).
+ */
+float getEvalUpperBound(const EvalContext *evalContext) {
+  if (SHOULD_PLAY_PERFECT) {
+    return 100; // The perfect play eval is a percent chance
+  }
+  FastEvalWeights const &weights = evalContext->weights;
+  // Every column full, counted with the 0.111111 weight used without a well (10 * 20 * 0.111111 = 22.2)
+  float maxAvgHeight = 22.3f;
+  float maxHeightRatio = maxAvgHeight / max(2.0f, evalContext->scareHeight);
+  // The built out left reward is at most avg height * (20 - avg height / 2) / scare height (col 1 at 20 and col 2 at
+  // 0), which peaks at 200 when the avg height is 20
+  float maxBuiltOutLeft = 200 / max(2.0f, evalContext->scareHeight);
+  // The most that col 1 can be under the avg height and col 2
+  float maxLowLeftDiff = 0.5f * maxAvgHeight + 0.5f * 20;
+  float maxCoveredWellRatio = 20 / max(3.0f, evalContext->scareHeight);
+  float maxCol9Diff = max(0.0f, 20 - evalContext->maxSafeCol9);
+  float maxCol9ScareRatio = 20 / max(2.0f, evalContext->scareHeight);
+  float maxAvgHeightDiff = max(0.0f, maxAvgHeight - evalContext->scareHeight);
+  // The accessible surface can be below the floor (on double killscreen), so a full column can stick up more than 20
+  int fullSurface[10] = {20, 20, 20, 20, 20, 20, 20, 20, 20, 20};
+  float maxLeftAbove = getHeightAboveAccessible(fullSurface, evalContext->pieceRangeContext.maxAccessibleLeft5Surface, 0, 7);
+  float maxRightAbove = getHeightAboveAccessible(fullSurface, evalContext->pieceRangeContext.maxAccessibleRightSurface, 5, 10);
+  // Each of the 8 diffs in the rank encoding can go 17 past the +/- 3 that the encoding covers
+  float maxExcessGap = 8 * 17;
+  // The rank byte is scaled to 33.8 (see rateSurface), then the excess gap is added on
+  float maxRawRank = 33.8f + max(0.0f, maxExcessGap * weights.extremeGapCoef);
+  float minRawRank = min(0.0f, maxExcessGap * weights.extremeGapCoef);
+  // Without ranks, the flatness starts at 30 and each of the 9 diffs can take off up to pow(20, 1.5) = 89.44, plus 25
+  // for a line dependency, and then 12 more if there's no flat spot (see calculateFlatness)
+  float minFlatness = 30 - 9 * (89.5f + 25) - 12;
+  float maxFlatness = 30;
+  float maxLineClearFactor = 0;
+  for (int numLines = 1; numLines <= 4; numLines++) {
+    maxLineClearFactor = max(maxLineClearFactor, getLineClearFactor(numLines, weights, evalContext->shouldRewardLineClears));
+  }
+
+  float total = maxLineClearFactor
+    + getMaxFactorValue(weights.avgHeightCoef, 0, maxAvgHeightDiff * maxAvgHeightDiff)
+    + getMaxFactorValue(weights.builtOutLeftCoef, -0.5f * maxLowLeftDiff * maxLowLeftDiff * 0.5f * (maxHeightRatio + 1), maxBuiltOutLeft)
+    + getMaxFactorValue(weights.coveredWellCoef, 0, maxCoveredWellRatio * maxCoveredWellRatio * maxCoveredWellRatio * 10)
+    + getMaxFactorValue(weights.burnCoef, 0, 20) // Guaranteed burns, at most one per row
+    + getMaxFactorValue(weights.burnCoef, 0, 6) // Likely burns, 0.6 for every 2 cells that col 9 is low by
+    + getMaxFactorValue(weights.col9Coef, 0, maxCol9Diff * maxCol9Diff)
+    + getMaxFactorValue(weights.holeCoef, 0, 200) // Every cell on the board
+    + getMaxFactorValue(weights.holeWeightCoef, 0, 20)
+    + getMaxFactorValue(weights.inaccessibleLeftCoef, 0, 1 + 0.2f * maxLeftAbove * maxLeftAbove)
+    + getMaxFactorValue(weights.inaccessibleRightCoef, 0, 1 + 0.2f * maxRightAbove * maxRightAbove)
+    // Both ways of rating the surface (the rank formula is increasing in the raw rank)
+    + getMaxFactorValue(weights.surfaceCoef, min(minRawRank + 2 - 70 / max(3.0f, minRawRank), minFlatness), max(maxRawRank + 2 - 70 / max(3.0f, maxRawRank), maxFlatness))
+    + getMaxFactorValue(weights.surfaceLeftCoef, -20, 0) // Col 1 can be up to 20 below col 2
+    + getMaxFactorValue(weights.tetrisReadyCoef, 0, 1)
+    // 8 columns that are each up to 20 under col 9 (20 * 20 * 8 = 3200), plus 50 for each of the 2 rows at col 9's
+    // surface and the 5 rows around it with a hole in it (350), scaled by how high col 9 is
+    + getMaxFactorValue(weights.unableToBurnCoef, 0, 3550 * maxCol9ScareRatio * maxCol9ScareRatio * maxCol9ScareRatio);
+  return max(weights.deathCoef, total);
+}
+
+/** Gets the surface features after a placement, updating the starting state's features unless lines were cleared. */
+SurfaceFeatures getSurfaceFeaturesAfterPlacement(GameState const &gameState,
+                                                 SurfaceFeatures const &gameStateSurfaceFeatures,
+                                                 GameState &newState,
+                                                 LockPlacement const &lockPlacement,
+                                                 const EvalContext *evalContext) {
+  // The SIMD kernels recompute every diff faster than the changed ones can be patched one at a time
+  if (newState.lines != gameState.lines || surfaceFeaturesKernel != getSurfaceFeaturesScalar) {
+    return getSurfaceFeatures(newState.surfaceArray, evalContext);
+  }
+  // Only the columns under the piece's 4x4 box can have changed
+  int startCol = max(0, lockPlacement.x);
+  int endCol = min(10, lockPlacement.x + 4);
+  return updateSurfaceFeatures(gameStateSurfaceFeatures, newState.surfaceArray, startCol, endCol, evalContext);
+}
+
+/**
+ * Same as fastEval, but reuses the surface features of the starting state (see getSurfaceFeatures) so that only the
+ * columns under the placed piece are looked at again. Falls back to the full eval if the placement cleared lines.
+ */
+float fastEvalIncremental(GameState gameState,
+                          SurfaceFeatures const &gameStateSurfaceFeatures,
+                          GameState newState,
+                          LockPlacement lockPlacement,
+                          const EvalContext *evalContext) {
+  if (SHOULD_PLAY_PERFECT || newState.lines != gameState.lines) {
+    return fastEval(gameState, newState, lockPlacement, evalContext);
+  }
+  EvalCacheEntry *cacheEntry = NULL;
+  if (shouldUseEvalCache() && lookUpEvalCache(gameState, newState, evalContext, cacheEntry)) {
+    return cacheEntry->evalScore;
+  }
+  SurfaceFeatures surfaceFeatures = getSurfaceFeaturesAfterPlacement(gameState, gameStateSurfaceFeatures, newState, lockPlacement, evalContext);
+  float evalScore = fastEvalWithSurfaceFeatures(gameState, newState, lockPlacement, surfaceFeatures, evalContext);
+  if (cacheEntry != NULL) {
+    storeInEvalCache(*cacheEntry, gameState, newState, evalContext, evalScore);
+  }
+  return evalScore;
+}
+
+/**
+ * Scores the states in a batch that are marked as pending. The surface features of every state are found first, and
+ * their ranks prefetched, so that the cache misses into the ranks table overlap instead of stalling one at a time.
+ */
+void evalPendingWithPrefetch(GameState const &gameState,
+                             SurfaceFeatures const &gameStateSurfaceFeatures,
+                             GameState newStates[],
+                             LockPlacement lockPlacements[],
+                             bool const isPending[],
+                             int numStates,
+                             const EvalContext *evalContext,
+                             OUT float evalScores[]) {
+  SurfaceFeatures surfaceFeatures[EVAL_BATCH_SIZE];
+  for (int i = 0; i < numStates; i++) {
+    if (!isPending[i]) {
+      continue;
+    }
+    surfaceFeatures[i] = getSurfaceFeaturesAfterPlacement(gameState, gameStateSurfaceFeatures, newStates[i], lockPlacements[i], evalContext);
+    if (USE_BASE_7_RANKS && surfaceRanks != NULL) {
+      PREFETCH(&surfaceRanks[surfaceFeatures[i].rankIndex]);
+    }
+  }
+  for (int i = 0; i < numStates; i++) {
+    if (isPending[i]) {
+      evalScores[i] = fastEvalWithSurfaceFeatures(gameState, newStates[i], lockPlacements[i], surfaceFeatures[i], evalContext);
+    }
+  }
+}
+
+/**
+ * Equivalent to calling fastEvalIncremental() on each of up to EVAL_BATCH_SIZE placements from the same starting state,
+ * but with the ranks table lookups overlapped (see evalPendingWithPrefetch).
+ */
+void fastEvalBatch(GameState gameState,
+                   SurfaceFeatures const &gameStateSurfaceFeatures,
+                   GameState newStates[],
+                   LockPlacement lockPlacements[],
+                   int numStates,
+                   const EvalContext *evalContext,
+                   OUT float evalScores[]) {
+  if (SHOULD_PLAY_PERFECT) {
+    for (int i = 0; i < numStates; i++) {
+      evalScores[i] = fastEval(gameState, newStates[i], lockPlacements[i], evalContext);
+    }
+    return;
+  }
+  bool isPending[EVAL_BATCH_SIZE] = {};
+  EvalCacheEntry *cacheEntries[EVAL_BATCH_SIZE] = {};
+  for (int i = 0; i < numStates; i++) {
+    isPending[i] = !(shouldUseEvalCache() && lookUpEvalCache(gameState, newStates[i], evalContext, cacheEntries[i]));
+    if (!isPending[i]) {
+      evalScores[i] = cacheEntries[i]->evalScore;
+    }
+  }
+  evalPendingWithPrefetch(gameState, gameStateSurfaceFeatures, newStates, lockPlacements, isPending, numStates, evalContext, evalScores);
+  for (int i = 0; i < numStates; i++) {
+    if (isPending[i] && cacheEntries[i] != NULL) {
+      storeInEvalCache(*cacheEntries[i], gameState, newStates[i], evalContext, evalScores[i]);
+    }
+  }
+}
+
+/* ----------- TESTS ----------- */
+
+/**
+ * Times the batched eval against evaluating the same placements one at a time (bypassing the eval cache for both),
+ * and checks that they give the same scores.
+ * @returns the number of placements where the two disagreed
+ */
+int benchmarkFastEvalBatch(unsigned int boards[][20], int numBoards, const EvalContext *evalContext, int iterations) {
+  // Collect every placement of every piece on each board
+  std::vector<GameState> startingStates;
+  std::vector<SurfaceFeatures> startingFeatures;
+  std::vector<std::vector<GameState>> newStatesByStart;
+  std::vector<LockPlacementList> placementsByStart;
+  for (int i = 0; i < numBoards; i++) {
+    GameState gameState = {{}, {}, 0, 0, 0, 18};
+    copyBoard(boards[i], gameState.board);
+    getSurfaceArray(gameState.board, gameState.surfaceArray);
+    updateSurfaceAndHoles(gameState.surfaceArray, gameState.board, evalContext->wellColumn, evalContext->aiMode == DIG);
+    for (int p = 0; p < 7; p++) {
+      LockPlacementList lockPlacements;
+      moveSearch(gameState, &PIECE_LIST[p], evalContext->pieceRangeContext, lockPlacements);
+      std::vector<GameState> newStates;
+      for (LockPlacement const &lockPlacement : lockPlacements) {
+        newStates.push_back(advanceGameState(gameState, lockPlacement, evalContext));
+      }
+      startingStates.push_back(gameState);
+      startingFeatures.push_back(getSurfaceFeatures(gameState.surfaceArray, evalContext));
+      newStatesByStart.push_back(newStates);
+      placementsByStart.push_back(lockPlacements);
+    }
+  }
+
+  std::vector<float> scalarScores;
+  std::vector<float> batchScores;
+  auto scalarStart = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; iter++) {
+    scalarScores.clear();
+    for (int s = 0; s < (int) startingStates.size(); s++) {
+      for (int i = 0; i < (int) newStatesByStart[s].size(); i++) {
+        SurfaceFeatures surfaceFeatures = getSurfaceFeaturesAfterPlacement(startingStates[s], startingFeatures[s], newStatesByStart[s][i], placementsByStart[s][i], evalContext);
+        scalarScores.push_back(fastEvalWithSurfaceFeatures(startingStates[s], newStatesByStart[s][i], placementsByStart[s][i], surfaceFeatures, evalContext));
+      }
+    }
+  }
+  auto batchStart = std::chrono::steady_clock::now();
+  bool isPending[EVAL_BATCH_SIZE];
+  for (int b = 0; b < EVAL_BATCH_SIZE; b++) {
+    isPending[b] = true;
+  }
+  float evalScores[EVAL_BATCH_SIZE];
+  for (int iter = 0; iter < iterations; iter++) {
+    batchScores.clear();
+    for (int s = 0; s < (int) startingStates.size(); s++) {
+      int numStates = (int) newStatesByStart[s].size();
+      for (int i = 0; i < numStates; i += EVAL_BATCH_SIZE) {
+        int batchSize = min(EVAL_BATCH_SIZE, numStates - i);
+        evalPendingWithPrefetch(startingStates[s], startingFeatures[s], &newStatesByStart[s][i], &placementsByStart[s][i], isPending, batchSize, evalContext, evalScores);
+        batchScores.insert(batchScores.end(), evalScores, evalScores + batchSize);
+      }
+    }
+  }
+  auto batchEnd = std::chrono::steady_clock::now();
+
+  int numMismatched = 0;
+  for (int i = 0; i < (int) scalarScores.size(); i++) {
+    numMismatched += memcmp(&scalarScores[i], &batchScores[i], sizeof(float)) == 0 ? 0 : 1;
+  }
+  long long scalarMicros = std::chrono::duration_cast<std::chrono::microseconds>(batchStart - scalarStart).count();
+  long long batchMicros = std::chrono::duration_cast<std::chrono::microseconds>(batchEnd - batchStart).count();
+  printf("Evaluated %d placements x %d iterations: one at a time %lldus, batched %lldus (%.2fx), %d mismatched\n",
+         (int) scalarScores.size(), iterations, scalarMicros, batchMicros, (double) scalarMicros / max(1LL, batchMicros), numMismatched);
+  return numMismatched;
+}
+
+/**
+ * Checks that fastEval never scores a placement above getEvalUpperBound, for every piece on random boards in every
+ * prebuilt context (see buildEvalContextLookup), at levels from 18 up to killscreen.
+ * @returns the number of placements that scored above the bound
+ */
+int testEvalUpperBound(int numBoards, char const *inputFrameTimeline) {
+  const InputTimeline inputTimeline = compileInputTimeline(inputFrameTimeline);
+  const PieceRangeContext pieceRangeContextLookup[4] = {
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 1, /* gravityDoubled= */ true),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 1, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 2, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 3, /* gravityDoubled= */ false),
+  };
+  EvalContextLookup evalContextLookup;
+  buildEvalContextLookup(pieceRangeContextLookup, evalContextLookup);
+
+  std::vector<GameState> randomStates;
+  makeRandomGameStates(numBoards, /* seed= */ 24680, /* minFillPercent= */ 30, randomStates);
+  int numOverBound = 0;
+  for (GameState const &randomState : randomStates) {
+    for (int mode = 0; mode < NUM_AI_MODES; mode++) {
+      for (int i = 0; i < NUM_PIECE_RANGE_CONTEXTS; i++) {
+        for (int band = 0; band < NUM_SCARE_HEIGHT_BANDS; band++) {
+          const EvalContext *evalContext = &evalContextLookup.contexts[mode][i][band];
+          float evalUpperBound = getEvalUpperBound(evalContext);
+          GameState gameState = randomState;
+          std::pair<int, float> holes = updateSurfaceAndHoles(gameState.surfaceArray, gameState.board, evalContext->countWellHoles ? -1 : evalContext->wellColumn, evalContext->aiMode == DIG);
+          gameState.numTrueHoles = holes.first;
+          gameState.numPartialHoles = holes.second;
+          for (int p = 0; p < 7; p++) {
+            LockPlacementList lockPlacements;
+            moveSearch(gameState, &PIECE_LIST[p], evalContext->pieceRangeContext, lockPlacements);
+            for (LockPlacement const &lockPlacement : lockPlacements) {
+              GameState newState = advanceGameState(gameState, lockPlacement, evalContext);
+              float evalScore = fastEval(gameState, newState, lockPlacement, evalContext);
+              if (evalScore > evalUpperBound) {
+                printf("Eval %f is over the bound %f (mode %d, context %d, band %d)\n", evalScore, evalUpperBound, mode, i, band);
+                printBoard(newState.board);
+                numOverBound++;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return numOverBound;
+}
+
+/**
+ * Checks that every SIMD surface kernel the CPU supports gives exactly the same surface features as
+ * getSurfaceFeaturesScalar, on random surfaces with and without a well in col 10, and with accessible surfaces both
+ * above and below the columns (so that the heights above them can come out negative before being clamped).
+ * @returns the number of surfaces where a kernel disagreed
+ */
+int testSurfaceFeaturesKernels(int numSurfaces) {
+  int numMismatched = 0;
+#if HAS_X86_SURFACE_KERNELS
+  __builtin_cpu_init();
+  SurfaceFeaturesKernel kernels[2];
+  char const *kernelNames[2];
+  int numKernels = 0;
+  if (__builtin_cpu_supports("sse4.1")) {
+    kernels[numKernels] = getSurfaceFeaturesSse4;
+    kernelNames[numKernels++] = "SSE4";
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels[numKernels] = getSurfaceFeaturesAvx2;
+    kernelNames[numKernels++] = "AVX2";
+  }
+
+  // Surfaces of random stacks, from flat (nearly full rows) to very uneven (sparse ones)
+  std::vector<GameState> gameStates;
+  makeRandomGameStates(numSurfaces, /* seed= */ 13579, /* minFillPercent= */ 0, gameStates);
+  // For the accessible surfaces and well column of each surface
+  std::mt19937 generator(13579);
+  EvalContext evalContext = {};
+  for (int i = 0; i < numSurfaces; i++) {
+    int *surfaceArray = gameStates[i].surfaceArray;
+    for (int c = 0; c < 10; c++) {
+      // Down to -6, as on double killscreen
+      evalContext.pieceRangeContext.maxAccessibleLeft5Surface[c] = (int) (generator() % 27) - 6;
+      evalContext.pieceRangeContext.maxAccessibleRightSurface[c] = (int) (generator() % 27) - 6;
+    }
+    evalContext.wellColumn = i % 2 == 0 ? 9 : (int) (generator() % 11) - 1;
+    SurfaceFeatures expected = getSurfaceFeaturesScalar(surfaceArray, &evalContext);
+    for (int k = 0; k < numKernels; k++) {
+      SurfaceFeatures actual = kernels[k](surfaceArray, &evalContext);
+      if (memcmp(&expected, &actual, sizeof(SurfaceFeatures)) != 0) {
+        printf("%s kernel mismatch with well column %d: rank index %d vs %d, excess gap %d vs %d, above accessible %d %d vs %d %d\n",
+               kernelNames[k], evalContext.wellColumn, expected.rankIndex, actual.rankIndex, expected.excessGap, actual.excessGap,
+               expected.leftHeightAboveAccessible, expected.rightHeightAboveAccessible, actual.leftHeightAboveAccessible, actual.rightHeightAboveAccessible);
+        printSurface(surfaceArray);
+        numMismatched++;
+      }
+    }
+  }
+#endif
+  return numMismatched;
+}
@@ -8,4 +8,21 @@ float getLineClearFactor(int numLinesCleared, FastEvalWeights weights, int shoul
 
 float fastEval(GameState gameState, GameState newState, LockPlacement lockPlacement, const EvalContext *evalContext);
 
+/** An upper bound on what fastEval can return in a given context. */
+float getEvalUpperBound(const EvalContext *evalContext);
+
+SurfaceFeatures getSurfaceFeatures(int surfaceArray[10], const EvalContext *evalContext);
+
+float fastEvalIncremental(GameState gameState, SurfaceFeatures const &gameStateSurfaceFeatures, GameState newState, LockPlacement lockPlacement, const EvalContext *evalContext);
+
+#define EVAL_BATCH_SIZE 16 // Enough placements to overlap the ranks table lookups, without keeping too many states around
+
+void fastEvalBatch(GameState gameState,
+                   SurfaceFeatures const &gameStateSurfaceFeatures,
+                   GameState newStates[],
+                   LockPlacement lockPlacements[],
+                   int numStates,
+                   const EvalContext *evalContext,
+                   OUT float evalScores[]);
+
 #endif
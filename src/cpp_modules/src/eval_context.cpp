@@ -1,6 +1,8 @@
 #include "eval_context.hpp"
+#include "surface_ranks.hpp"
 #include <math.h>
 #include <algorithm>
+#include <string.h>
 #include "config.hpp"
 
 // Unused
@@ -29,11 +31,21 @@ int hasHoleBlockingTetrisReady(unsigned int board[20], int col10Height){
   return false;
 }
 
+/** The part of picking the AI mode that only depends on the level and lines (see getAiMode). */
+bool shouldLineOut(int lines, int currentMax5TapHeight) {
+  return (ALWAYS_LINEOUT_29 && lines > 226) || currentMax5TapHeight < 4 || ALWAYS_LINEOUT;
+}
+
+/** The part of picking the AI mode that only depends on the level and lines (see getAiMode). */
+bool isNearKillscreen(int level, int lines, int max5TapHeight29) {
+  return max5TapHeight29 < 2 && lines > 220 && level < 29;
+}
+
 AiMode getAiMode(GameState gameState, int currentMax5TapHeight, int max5TapHeight29) {
-  if ((ALWAYS_LINEOUT_29 && gameState.lines > 226) || currentMax5TapHeight < 4 || ALWAYS_LINEOUT) {
+  if (shouldLineOut(gameState.lines, currentMax5TapHeight)) {
     return LINEOUT;
   }
-  if (max5TapHeight29 < 2 && gameState.lines > 220 && gameState.level < 29) {
+  if (isNearKillscreen(gameState.level, gameState.lines, max5TapHeight29)) {
     if (hasHoleBlockingTetrisReady(gameState.board, gameState.surfaceArray[9])) {
       return DIRTY_NEAR_KILLSCREEN;
     }
@@ -49,18 +61,74 @@ AiMode getAiMode(GameState gameState, int currentMax5TapHeight, int max5TapHeigh
   return STANDARD;
 }
 
-const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pieceRangeContextLookup[]){
+/** Adds a 32-bit value to an FNV-1a hash. */
+unsigned long long addToHash(unsigned long long hash, unsigned int value) {
+  return (hash ^ value) * 1099511628211ULL;
+}
+
+unsigned int getFloatBits(float value) {
+  unsigned int bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+/**
+ * Hashes the parts of an eval context that the eval reads, so that cached evals are only reused in the same context.
+ * Needs to be recalculated whenever one of those fields is changed. The surface ranks are global rather than part of
+ * the context, so the key includes which set of them was loaded.
+ */
+unsigned long long getEvalCacheKey(EvalContext const &context) {
+  unsigned long long hash = 14695981039346656037ULL;
+  hash = addToHash(hash, context.aiMode);
+  FastEvalWeights const &weights = context.weights;
+  float coefs[] = {weights.avgHeightCoef, weights.builtOutLeftCoef, weights.burnCoef, weights.coveredWellCoef,
+                   weights.col9Coef, weights.deathCoef, weights.extremeGapCoef, weights.holeCoef,
+                   weights.holeWeightCoef, weights.inaccessibleLeftCoef, weights.inaccessibleRightCoef, weights.tetrisCoef,
+                   weights.tetrisReadyCoef, weights.surfaceCoef, weights.surfaceLeftCoef, weights.unableToBurnCoef};
+  for (float coef : coefs) {
+    hash = addToHash(hash, getFloatBits(coef));
+  }
+  hash = addToHash(hash, context.pieceRangeContext.max5TapHeight);
+  for (int i = 0; i < 10; i++) {
+    hash = addToHash(hash, context.pieceRangeContext.maxAccessibleLeft5Surface[i]);
+    hash = addToHash(hash, context.pieceRangeContext.maxAccessibleRightSurface[i]);
+  }
+  hash = addToHash(hash, getFloatBits(context.maxSafeCol9));
+  hash = addToHash(hash, getFloatBits(context.scareHeight));
+  hash = addToHash(hash, context.shouldRewardLineClears);
+  hash = addToHash(hash, context.wellColumn);
+  hash = addToHash(hash, surfaceRanksGeneration);
+  return hash;
+}
+
+/** The index into the piece range context lookup for a level. */
+int getPieceRangeContextIndex(int level) {
+  return isGravityDoubled(level)
+          ? 0 // double killscreen context is at index 0 of the array
+          : getGravity(level); // The rest are indexed by the gravity value
+}
+
+/**
+ * Sorts the levels and line counts into the bands that have different scare heights.
+ * The lowest bit is whether to play safe at the level, and the rest is the progress towards the double killscreen
+ * scare height (see buildEvalContext).
+ */
+int getScareHeightBand(int level, int lines) {
+  bool lowerScareHeight = (PLAY_SAFE_PRE_KILLSCREEN && level < 29) || (PLAY_SAFE_ON_KILLSCREEN && level >= 29);
+  int interpolationStep = 0;
+  if (DOUBLE_KILLSCREEN_ENABLED && lines > DOUBLE_KILLSCREEN_CUTOFF_LINES){
+    interpolationStep = std::min(DOUBLE_KILLSCREEN_INTERPOLATION_LINES, lines - DOUBLE_KILLSCREEN_CUTOFF_LINES);
+  }
+  return interpolationStep * 2 + (lowerScareHeight ? 1 : 0);
+}
+
+EvalContext buildEvalContext(AiMode aiMode, int pieceRangeContextIndex, int scareHeightBand, const PieceRangeContext pieceRangeContextLookup[]){
   EvalContext context = {};
 
   // Copy the piece range context from the global lookup
-  bool gravityDoubled = isGravityDoubled(gameState.level);
-  int pieceRangeContextIndex = gravityDoubled 
-          ? 0 // double killscreen context is at index 0 of the array 
-          : getGravity(gameState.level); // The rest are indexed by the gravity value
   context.pieceRangeContext = pieceRangeContextLookup[pieceRangeContextIndex];
 
   // Set the mode
-  AiMode aiMode = getAiMode(gameState, context.pieceRangeContext.max5TapHeight, pieceRangeContextLookup[0].max5TapHeight);
   context.aiMode = aiMode;
   context.weights = getWeights(context.aiMode);
 
@@ -69,25 +137,17 @@ const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pi
     context.scareHeight = 0;
     context.maxSafeCol9 = -1;
   } else {
-    bool lowerScareHeight = (PLAY_SAFE_PRE_KILLSCREEN && gameState.level < 29) || (PLAY_SAFE_ON_KILLSCREEN && gameState.level >= 29);
+    bool lowerScareHeight = scareHeightBand % 2 == 1;
     float prelimScareHeight = context.pieceRangeContext.max5TapHeight - (lowerScareHeight ? 4 : 3);
     float prelimCol9 = context.pieceRangeContext.max4TapHeight - (lowerScareHeight ? 6 : 5);
 
     prelimScareHeight = prelimScareHeight * 0.5 + 6 * 0.5;
     prelimCol9 = prelimCol9 * 0.5 + 8 * 0.5;
 
-    // FOR TESTING
-    float ratio = 0;
+    // Slowly shift from the killscreen scare height to the double killscreen scare height
+    int interpolationStep = scareHeightBand / 2;
+    float ratio = (float)interpolationStep / (float)DOUBLE_KILLSCREEN_INTERPOLATION_LINES;
 
-    if (DOUBLE_KILLSCREEN_ENABLED){
-      int cutoffLines = 320;
-      int linearInterpolationLines = 10; // Slowly shift from the killscreen scare height to the double killscreen scare height
-      if (gameState.lines > cutoffLines){
-        int diff = std::min(linearInterpolationLines, gameState.lines - cutoffLines);
-        ratio = (float)diff / (float)linearInterpolationLines;
-      }
-    }
-    
     context.scareHeight = prelimScareHeight * (1.0 - ratio);
     context.maxSafeCol9 = prelimCol9 * (1.0 - ratio);
   }
@@ -104,7 +164,71 @@ const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pi
   // context.countWellHoles = context.aiMode == DIG   // This turns out to not work in practice, it prevents filling the well to clear holes.
   context.countWellHoles = false;
   context.shouldRewardLineClears = (aiMode == LINEOUT || aiMode == DIRTY_NEAR_KILLSCREEN);
+  context.evalCacheKey = getEvalCacheKey(context);
 
   return context;
 }
 
+const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pieceRangeContextLookup[]){
+  int pieceRangeContextIndex = getPieceRangeContextIndex(gameState.level);
+  AiMode aiMode = getAiMode(gameState, pieceRangeContextLookup[pieceRangeContextIndex].max5TapHeight, pieceRangeContextLookup[0].max5TapHeight);
+  return buildEvalContext(aiMode, pieceRangeContextIndex, getScareHeightBand(gameState.level, gameState.lines), pieceRangeContextLookup);
+}
+
+/**
+ * Builds every eval context that a request could need, so that playouts only need to reclassify the mode after
+ * each move, rather than rebuild the context.
+ */
+void buildEvalContextLookup(const PieceRangeContext pieceRangeContextLookup[], OUT EvalContextLookup &evalContextLookup){
+  evalContextLookup.pieceRangeContextLookup = pieceRangeContextLookup;
+  for (int mode = 0; mode < NUM_AI_MODES; mode++) {
+    for (int i = 0; i < NUM_PIECE_RANGE_CONTEXTS; i++) {
+      for (int band = 0; band < NUM_SCARE_HEIGHT_BANDS; band++) {
+        evalContextLookup.contexts[mode][i][band] = buildEvalContext((AiMode) mode, i, band, pieceRangeContextLookup);
+      }
+    }
+  }
+}
+
+/**
+ * Finds every prebuilt context that a playout could switch into within a number of moves, going by how far the level
+ * and lines could get. The board decides between the modes that are left, so those are all included.
+ */
+void getReachableEvalContexts(GameState const &gameState, int numMoves, EvalContextLookup const &evalContextLookup, OUT std::vector<const EvalContext *> &contexts){
+  const PieceRangeContext *pieceRangeContextLookup = evalContextLookup.pieceRangeContextLookup;
+  bool isReachable[NUM_AI_MODES][NUM_PIECE_RANGE_CONTEXTS][NUM_SCARE_HEIGHT_BANDS] = {};
+  for (int linesCleared = 0; linesCleared <= 4 * numMoves; linesCleared++) {
+    int lines = gameState.lines + linesCleared;
+    // The level goes up at most once every 10 lines
+    for (int level = gameState.level; level <= gameState.level + linesCleared / 10 + 1; level++) {
+      int pieceRangeContextIndex = getPieceRangeContextIndex(level);
+      int band = getScareHeightBand(level, lines);
+      if (shouldLineOut(lines, pieceRangeContextLookup[pieceRangeContextIndex].max5TapHeight)) {
+        isReachable[LINEOUT][pieceRangeContextIndex][band] = true;
+      } else if (isNearKillscreen(level, lines, pieceRangeContextLookup[0].max5TapHeight)) {
+        isReachable[NEAR_KILLSCREEN][pieceRangeContextIndex][band] = true;
+        isReachable[DIRTY_NEAR_KILLSCREEN][pieceRangeContextIndex][band] = true;
+      } else {
+        isReachable[STANDARD][pieceRangeContextIndex][band] = true;
+        isReachable[DIG][pieceRangeContextIndex][band] = true;
+      }
+    }
+  }
+  for (int mode = 0; mode < NUM_AI_MODES; mode++) {
+    for (int i = 0; i < NUM_PIECE_RANGE_CONTEXTS; i++) {
+      for (int band = 0; band < NUM_SCARE_HEIGHT_BANDS; band++) {
+        if (isReachable[mode][i][band]) {
+          contexts.push_back(&evalContextLookup.contexts[mode][i][band]);
+        }
+      }
+    }
+  }
+}
+
+/** Same as getEvalContext, but picks the context out of the prebuilt ones. */
+const EvalContext *lookUpEvalContext(GameState const &gameState, EvalContextLookup const &evalContextLookup){
+  const PieceRangeContext *pieceRangeContextLookup = evalContextLookup.pieceRangeContextLookup;
+  int pieceRangeContextIndex = getPieceRangeContextIndex(gameState.level);
+  AiMode aiMode = getAiMode(gameState, pieceRangeContextLookup[pieceRangeContextIndex].max5TapHeight, pieceRangeContextLookup[0].max5TapHeight);
+  return &evalContextLookup.contexts[aiMode][pieceRangeContextIndex][getScareHeightBand(gameState.level, gameState.lines)];
+}
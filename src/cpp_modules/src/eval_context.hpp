@@ -1,3 +1,11 @@
 #include "types.hpp"
 
-const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pieceRangeContextLookup[]);
\ No newline at end of file
+const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pieceRangeContextLookup[]);
+
+void buildEvalContextLookup(const PieceRangeContext pieceRangeContextLookup[], OUT EvalContextLookup &evalContextLookup);
+
+const EvalContext *lookUpEvalContext(GameState const &gameState, EvalContextLookup const &evalContextLookup);
+
+void getReachableEvalContexts(GameState const &gameState, int numMoves, EvalContextLookup const &evalContextLookup, OUT std::vector<const EvalContext *> &contexts);
+
+unsigned long long getEvalCacheKey(EvalContext const &context);
\ No newline at end of file
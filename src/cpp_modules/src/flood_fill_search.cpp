@@ -0,0 +1,387 @@
+#include "flood_fill_search.hpp"
+
+#include <array>
+#include <stdio.h>
+#include <string.h>
+#include "utils.hpp"
+#include "types.hpp"
+using namespace std;
+
+/*
+   The flood fill search finds every reachable lock position in one pass over the frames.
+
+   Reachable piece origins are stored as bitmasks, one per rotation, where bit N means the piece's origin is at
+   x = N - FLOOD_FILL_X_OFFSET. Gravity doesn't depend on the inputs, so every position that's reachable on a
+   given frame is at the same y value. That means one frame of inputs (for every path at once) is just a few
+   shifts and ANDs against the precomputed masks of which origins are free at that y value.
+ */
+
+#define FLOOD_FILL_X_OFFSET 4 // The lowest X value representable is -4
+#define FLOOD_FILL_Y_OFFSET 4 // The lowest Y value representable is -4
+#define FLOOD_FILL_NUM_ROWS 32
+#define FLOOD_FILL_MAX_FRAMES 128 // Comfortably more than the 22 rows * 3 frames it takes to fall at level 18
+#define FLOOD_FILL_WALL_BITS (15U | (~0U << 14)) // The padded columns to the left and right of the board
+#define ALL_ORIGIN_BITS 0xFFFFU
+#define ORIGIN_BIT(x) (1U << ((x) + FLOOD_FILL_X_OFFSET))
+#define ROW_INDEX(y) ((y) + FLOOD_FILL_Y_OFFSET)
+
+/** Maps each 10-bit board row to its mirror image, such that column N ends up in bit N. */
+array<unsigned short, 1024> getMirroredRowTable() {
+  array<unsigned short, 1024> table = {};
+  for (int row = 0; row < 1024; row++) {
+    for (int col = 0; col < 10; col++) {
+      if (row & CELL_BIT(col)) {
+        table[row] |= 1 << col;
+      }
+    }
+  }
+  return table;
+}
+
+const array<unsigned short, 1024> MIRRORED_ROW_TABLE = getMirroredRowTable();
+
+/** The cells of one piece in one rotation, relative to its origin. */
+struct PieceCells {
+  int numCells;
+  int rows[4];
+  int cols[4];
+};
+
+array<array<PieceCells, 4>, 7> getPieceCellTable() {
+  array<array<PieceCells, 4>, 7> table = {};
+  for (int p = 0; p < 7; p++) {
+    for (int rot = 0; rot < 4; rot++) {
+      PieceCells &cells = table[p][rot];
+      if (PIECE_LIST[p].rowsByRotation[rot][0] == NONE) {
+        continue;
+      }
+      for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+          if (PIECE_LIST[p].rowsByRotation[rot][r] & CELL_BIT(c)) {
+            cells.rows[cells.numCells] = r;
+            cells.cols[cells.numCells] = c;
+            cells.numCells++;
+          }
+        }
+      }
+    }
+  }
+  return table;
+}
+
+const array<array<PieceCells, 4>, 7> PIECE_CELL_TABLE = getPieceCellTable();
+
+/** Everything the search records, such that the inputs for a given placement can be traced back afterwards. */
+struct FloodFillSearch {
+  unsigned int paddedRows[FLOOD_FILL_NUM_ROWS];
+  // The origins where the piece doesn't collide, by rotation and y value. Filled in lazily as the piece falls.
+  unsigned int freeOrigins[4][FLOOD_FILL_NUM_ROWS];
+  bool isSameAsRowAbove[FLOOD_FILL_NUM_ROWS]; // Whether the free origins are the same as one row up, for every rotation
+  int firstRowComputed; // The spawn row, which has no computed row above it to compare to
+  int numRowsComputed;
+  unsigned int lockedOrigins[4][FLOOD_FILL_NUM_ROWS]; // The origins where the piece locked, by rotation and y value
+  unsigned int frontierByFrame[FLOOD_FILL_MAX_FRAMES][4]; // The reachable origins going into each frame, by rotation
+  int yByFrame[FLOOD_FILL_MAX_FRAMES];
+  int lockFrameByY[FLOOD_FILL_NUM_ROWS];
+};
+
+int getNumOrientations(const Piece *piece) {
+  return piece->id == 'O'                    ? 1
+         : piece->rowsByRotation[3][0] == NONE ? 2
+                                               : 4;
+}
+
+/**
+ * Re-encodes each row of the board such that bit (col + 4) is set if that column is filled, and the columns off
+ * the sides of the board are always filled. Shifting a padded row right by the column of one of the piece's cells
+ * then gives, for every origin at once, whether that cell collides.
+ */
+void getPaddedRows(unsigned int board[20], OUT unsigned int paddedRows[FLOOD_FILL_NUM_ROWS]) {
+  for (int i = 0; i < FLOOD_FILL_NUM_ROWS; i++) {
+    int y = i - FLOOD_FILL_Y_OFFSET;
+    if (y < 0) {
+      paddedRows[i] = FLOOD_FILL_WALL_BITS;
+      continue;
+    }
+    if (y >= 20) {
+      paddedRows[i] = ~0U; // The floor
+      continue;
+    }
+    paddedRows[i] = FLOOD_FILL_WALL_BITS | ((unsigned int) MIRRORED_ROW_TABLE[board[y] & FULL_ROW] << FLOOD_FILL_X_OFFSET);
+  }
+}
+
+/** Calculates the origins where the piece fits, for each rotation, for all the y values down to a given one. */
+void computeFreeOriginsThroughY(const Piece *piece, int numOrientations, int y, OUT FloodFillSearch &search) {
+  for (; search.numRowsComputed <= ROW_INDEX(y); search.numRowsComputed++) {
+    int i = search.numRowsComputed;
+    bool hasRowAbove = i > search.firstRowComputed;
+    bool isSameAsRowAbove = hasRowAbove;
+    for (int rot = 0; rot < numOrientations; rot++) {
+      PieceCells const &cells = PIECE_CELL_TABLE[piece->index][rot];
+      unsigned int freeOrigins = 0; // Well below the floor
+      if (i + 4 <= FLOOD_FILL_NUM_ROWS) {
+        unsigned int blocked = 0;
+        for (int cell = 0; cell < cells.numCells; cell++) {
+          blocked |= search.paddedRows[i + cells.rows[cell]] >> cells.cols[cell];
+        }
+        freeOrigins = ~blocked & ALL_ORIGIN_BITS;
+      }
+      if (hasRowAbove && freeOrigins != search.freeOrigins[rot][i - 1]) {
+        isSameAsRowAbove = false;
+      }
+      search.freeOrigins[rot][i] = freeOrigins;
+    }
+    search.isSameAsRowAbove[i] = isSameAsRowAbove;
+  }
+}
+
+/**
+ * Applies one input frame to the set of reachable origins. On each input frame, the piece can optionally shift and
+ * then optionally rotate, and each of those steps has to be collision-free.
+ * @returns whether any new origins were reached
+ */
+bool expandByInputs(unsigned int freeOrigins[4][FLOOD_FILL_NUM_ROWS], int y, int numOrientations, OUT unsigned int frontier[4]) {
+  unsigned int expanded[4] = {};
+  for (int rot = 0; rot < numOrientations; rot++) {
+    unsigned int reachable = frontier[rot];
+    if (reachable == 0) {
+      continue;
+    }
+    unsigned int freeHere = freeOrigins[rot][ROW_INDEX(y)];
+    // No shift, shift left, or shift right
+    unsigned int afterShift = reachable | ((reachable >> 1) & freeHere) | ((reachable << 1) & freeHere);
+    expanded[rot] |= afterShift;
+    if (numOrientations > 1) {
+      int rightRot = (rot + 1) % numOrientations;
+      int leftRot = (rot + numOrientations - 1) % numOrientations;
+      expanded[rightRot] |= afterShift & freeOrigins[rightRot][ROW_INDEX(y)];
+      expanded[leftRot] |= afterShift & freeOrigins[leftRot][ROW_INDEX(y)];
+    }
+  }
+  bool didExpand = memcmp(frontier, expanded, sizeof(expanded)) != 0;
+  memcpy(frontier, expanded, sizeof(expanded));
+  return didExpand;
+}
+
+/** Checks if any column of the piece is below the surface, i.e. it couldn't have gotten there by dropping straight down. */
+bool isUnderOverhang(const Piece *piece, int x, int y, int rot, int surfaceArray[10]) {
+  unsigned int const *bottomSurface = piece->bottomSurfaceByRotation[rot];
+  for (int c = 0; c < 4; c++) {
+    if (bottomSurface[c] == NONE) {
+      continue; // Skip columns that the piece doesn't occupy
+    }
+    if (20 - (int) bottomSurface[c] - y < surfaceArray[x + c]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Walks back through the frontier history to find the last input that moved the piece before it locked.
+ * For a placement under an overhang, that's the tuck (or spin).
+ * @returns the notation of the input, or NO_TUCK_NOTATION if the piece could have been there since spawn
+ */
+char findLastInput(FloodFillSearch const &search, int numOrientations, int x, int rot, int lockFrame, OUT int &inputFrame) {
+  for (int frameIndex = lockFrame; frameIndex >= 0; frameIndex--) {
+    if (search.frontierByFrame[frameIndex][rot] & ORIGIN_BIT(x)) {
+      continue; // It was already here going into this frame
+    }
+    // Otherwise it was moved here by this frame's input
+    int y = search.yByFrame[frameIndex];
+    for (TuckInput tuckInput : TUCK_INPUTS) {
+      if (tuckInput.rotationChange != 0 && numOrientations == 1) {
+        continue;
+      }
+      int preInputRot = (rot - tuckInput.rotationChange + 4) % numOrientations;
+      int preInputX = x - tuckInput.xChange;
+      // The piece has to fit after just the shift, since the order goes Shift -> Rotate
+      if ((search.frontierByFrame[frameIndex][preInputRot] & ORIGIN_BIT(preInputX))
+          && (search.freeOrigins[preInputRot][ROW_INDEX(y)] & ORIGIN_BIT(x))) {
+        inputFrame = frameIndex;
+        return tuckInput.notation;
+      }
+    }
+    debugPrint("Flood fill found no input leading to x=%d rot=%d on frame %d\n", x, rot, frameIndex);
+    break;
+  }
+  return NO_TUCK_NOTATION;
+}
+
+/**
+ * Move search engine that expands the reachable origins frame by frame, rather than simulating each path.
+ * Finds every lock placement (including tucks and spins, no matter how many inputs they take) in a single pass.
+ */
+int floodFillSearch(GameState gameState, const Piece *piece, InputTimeline const &inputTimeline, OUT LockPlacementList &lockPlacements) {
+  int gravity = getGravity(gameState.level);
+  bool gravityDoubled = isGravityDoubled(gameState.level);
+  int numOrientations = getNumOrientations(piece);
+
+  // Not zeroed, since it's large. The rows are computed from the spawn row down, and the frame history is written
+  // before it's read.
+  FloodFillSearch search;
+  getPaddedRows(gameState.board, search.paddedRows);
+
+  int initialY = piece->initialY;
+  int y = initialY;
+  search.firstRowComputed = ROW_INDEX(y);
+  search.numRowsComputed = ROW_INDEX(y);
+  computeFreeOriginsThroughY(piece, numOrientations, y, search);
+  unsigned int frontier[4] = {};
+  frontier[0] = ORIGIN_BIT(INITIAL_X) & search.freeOrigins[0][ROW_INDEX(y)];
+  if (frontier[0] == 0) {
+    return 0; // Immediate collision on spawn
+  }
+
+  // Once the inputs stop reaching anything new, they can't until the piece falls to a row with different collisions.
+  // This skips most of the input frames while the piece is above the stack.
+  bool isSettled = false;
+
+  // Loop through hypothetical frames until every path has locked
+  int frameIndex = 0;
+  int timelineIndex = 0; // Equal to frameIndex % period, without the division every frame
+  int framesUntilGravity = gravity;
+  while (frontier[0] | frontier[1] | frontier[2] | frontier[3]) {
+    if (frameIndex >= FLOOD_FILL_MAX_FRAMES) {
+      debugPrint("Flood fill search ran for more than %d frames\n", FLOOD_FILL_MAX_FRAMES);
+      break;
+    }
+    memcpy(search.frontierByFrame[frameIndex], frontier, sizeof(frontier));
+    search.yByFrame[frameIndex] = y;
+
+    if (!isSettled && ((inputTimeline.inputFrameMask >> timelineIndex) & 1)) {
+      isSettled = !expandByInputs(search.freeOrigins, y, numOrientations, frontier);
+    }
+
+    // Gravity happens every Nth frame, where N = gravity
+    if (--framesUntilGravity == 0) {
+      framesUntilGravity = gravity;
+      for (int i = 0; i < (gravityDoubled ? 2 : 1); i++) {
+        computeFreeOriginsThroughY(piece, numOrientations, y + 1, search);
+        for (int rot = 0; rot < numOrientations; rot++) {
+          unsigned int freeBelow = search.freeOrigins[rot][ROW_INDEX(y + 1)];
+          search.lockedOrigins[rot][ROW_INDEX(y)] = frontier[rot] & ~freeBelow;
+          frontier[rot] &= freeBelow;
+        }
+        search.lockFrameByY[ROW_INDEX(y)] = frameIndex;
+        y++;
+        isSettled = isSettled && search.isSameAsRowAbove[ROW_INDEX(y)];
+      }
+    }
+    frameIndex++;
+    timelineIndex = timelineIndex + 1 == inputTimeline.period ? 0 : timelineIndex + 1;
+  }
+
+  // Every row that the piece fell through has its lock masks filled in
+  for (int rot = 0; rot < numOrientations; rot++) {
+    for (int i = ROW_INDEX(initialY); i < ROW_INDEX(y); i++) {
+      unsigned int locked = search.lockedOrigins[rot][i];
+      for (int bit = 0; locked != 0; bit++, locked >>= 1) {
+        if (!(locked & 1)) {
+          continue;
+        }
+        int lockX = bit - FLOOD_FILL_X_OFFSET;
+        int lockY = i - FLOOD_FILL_Y_OFFSET;
+        if (!isUnderOverhang(piece, lockX, lockY, rot, gameState.surfaceArray)) {
+          lockPlacements.push_back({lockX, lockY, rot, -1, NO_TUCK_NOTATION, piece});
+          continue;
+        }
+        if (!CAN_TUCK) {
+          continue;
+        }
+        int tuckFrame = -1;
+        char tuckInput = findLastInput(search, numOrientations, lockX, rot, search.lockFrameByY[i], tuckFrame);
+        lockPlacements.push_back({lockX, lockY, rot, tuckFrame, tuckInput, piece});
+      }
+    }
+  }
+  return (int) lockPlacements.size();
+}
+
+/* ----------- TESTS ----------- */
+
+/**
+ * Replays the input that the flood fill reported for a tuck: it has to happen on an input frame, fit through the
+ * board (see fitsThroughTuck), and leave the piece to fall straight into the lock position.
+ */
+bool isTuckInputReproducible(GameState const &gameState, LockPlacement const &tuck, InputTimeline const &inputTimeline) {
+  if (tuck.tuckFrame < 0 || !shouldPerformInputsThisFrame(tuck.tuckFrame, inputTimeline)) {
+    return false;
+  }
+  const TuckInput *tuckInput = NULL;
+  for (TuckInput const &candidate : TUCK_INPUTS) {
+    if (candidate.notation == tuck.tuckInput) {
+      tuckInput = &candidate;
+    }
+  }
+  if (tuckInput == NULL) {
+    return false;
+  }
+  // Gravity happens at the end of every Nth frame (see floodFillSearch)
+  int gravity = getGravity(gameState.level);
+  int tuckY = tuck.piece->initialY + (tuck.tuckFrame / gravity) * (isGravityDoubled(gameState.level) ? 2 : 1);
+  SimState afterTuckState = {tuck.x, tuckY, tuck.rotationIndex, tuck.tuckFrame, /* arrIndex= */ 0, tuck.piece};
+  int preTuckX;
+  int preTuckRotIndex;
+  getPreTuckState(afterTuckState, *tuckInput, preTuckX, preTuckRotIndex);
+  unsigned int board[20];
+  memcpy(board, gameState.board, sizeof(board));
+  if (tuckY > tuck.y || !fitsThroughTuck(board, afterTuckState, preTuckX, preTuckRotIndex)
+      || collision(board, tuck.piece, tuck.x, tuckY, tuck.rotationIndex)) {
+    return false;
+  }
+  int lockY = tuckY;
+  while (!collision(board, tuck.piece, tuck.x, lockY + 1, tuck.rotationIndex)) {
+    lockY++;
+  }
+  return lockY == tuck.y;
+}
+
+/**
+ * Checks that the flood fill finds every standard placement that the frame simulation engine does, and that the input
+ * it reports for each tuck actually gets the piece there (see isTuckInputReproducible).
+ * The tucks themselves aren't compared, since findTucks only checks that a tuck is within a range of y values, and can
+ * find tucks on y values where no input frame actually happens.
+ * @returns the number of placements that were missing, plus the number of tucks with a wrong input
+ */
+int testFloodFillSearch(unsigned int board[20], int level, char const *inputFrameTimeline) {
+  GameState gameState = {{}, {}, 0, 0, 0, level};
+  copyBoard(board, gameState.board);
+  getSurfaceArray(gameState.board, gameState.surfaceArray);
+  updateSurfaceAndHoles(gameState.surfaceArray, gameState.board, /* wellColumn= */ 9, /* isDigMode= */ false);
+  InputTimeline inputTimeline = compileInputTimeline(inputFrameTimeline);
+
+  int numMissing = 0;
+  for (int p = 0; p < 7; p++) {
+    const Piece *piece = &PIECE_LIST[p];
+    SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+    LockPlacementList simulated;
+    LockPlacementList floodFilled;
+    moveSearchInternal(gameState, spawnState, piece, inputTimeline, /* moveTemplate= */ NULL, simulated);
+    floodFillSearch(gameState, piece, inputTimeline, floodFilled);
+    for (LockPlacement const &expected : simulated) {
+      if (expected.tuckInput != NO_TUCK_NOTATION) {
+        continue;
+      }
+      bool found = false;
+      for (LockPlacement const &actual : floodFilled) {
+        if (actual.x == expected.x && actual.y == expected.y && actual.rotationIndex == expected.rotationIndex) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        printf("Flood fill missed %c: x=%d y=%d rot=%d\n", piece->id, expected.x, expected.y, expected.rotationIndex);
+        numMissing++;
+      }
+    }
+    for (LockPlacement const &actual : floodFilled) {
+      if (actual.tuckInput != NO_TUCK_NOTATION && !isTuckInputReproducible(gameState, actual, inputTimeline)) {
+        printf("Flood fill tuck %c %c on frame %d doesn't reach x=%d y=%d rot=%d\n", piece->id, actual.tuckInput, actual.tuckFrame, actual.x, actual.y, actual.rotationIndex);
+        numMissing++;
+      }
+    }
+  }
+  return numMissing;
+}
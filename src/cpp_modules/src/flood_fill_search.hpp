@@ -0,0 +1,9 @@
+#ifndef FLOOD_FILL_SEARCH
+#define FLOOD_FILL_SEARCH
+
+#include "types.hpp"
+#include "utils.hpp"
+
+int floodFillSearch(GameState gameState, const Piece *piece, InputTimeline const &inputTimeline, OUT LockPlacementList &lockPlacements);
+
+#endif
@@ -8,14 +8,8 @@ const int SCORE_REWARDS[] = {
   1200
 };
 
-int countInputsBeforeReactionTime(int reactionTime, char const *inputFrameTimeline) {
-  int numInputs = 0;
-  for (int i = 0; i < reactionTime; i++){
-    if (shouldPerformInputsThisFrame(i, inputFrameTimeline)){
-      numInputs++;
-    }
-  }
-  return numInputs;
+int countInputsBeforeReactionTime(int reactionTime, InputTimeline const &inputTimeline) {
+  return countInputsBeforeFrame(reactionTime, inputTimeline);
 }
 
 int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, int playoutCount, int playoutLength){
@@ -33,12 +27,15 @@ int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines
   Piece nextPiece = PIECE_LIST[qualityRandom(0,7)];
 
   // Calculate global context for the 4 possible gravity values
+  const InputTimeline inputTimeline = compileInputTimeline(inputFrameTimeline);
   const PieceRangeContext pieceRangeContextLookup[4] = {
-    getPieceRangeContext(inputFrameTimeline, 1, /* gravityDoubled= */ true),
-    getPieceRangeContext(inputFrameTimeline, 1, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline, 2, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline, 3, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 1, /* gravityDoubled= */ true),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 1, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 2, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, DEFAULT_MOVE_SEARCH_ENGINE, 3, /* gravityDoubled= */ false),
   };
+  EvalContextLookup evalContextLookup;
+  buildEvalContextLookup(pieceRangeContextLookup, evalContextLookup);
   int score = 0;
   int numMoves = 0;
 
@@ -50,10 +47,9 @@ int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines
     nextPiece = getRandomPiece(curPiece);
 
     // Figure out modes and eval context
-    const EvalContext evalContextRaw = getEvalContext(gameState, pieceRangeContextLookup);
-    const EvalContext *evalContext = &evalContextRaw;
+    const EvalContext *evalContext = lookUpEvalContext(gameState, evalContextLookup);
 
-    LockLocation bestMove = playOneMove(gameState, &curPiece, NULL, DEFAULT_PRUNING_BREADTH, playoutCount, playoutLength, evalContext, pieceRangeContextLookup);
+    LockLocation bestMove = playOneMove(gameState, &curPiece, NULL, DEFAULT_PRUNING_BREADTH, playoutCount, playoutLength, evalContext, evalContextLookup, DEFAULT_PLAYOUT_BUDGET);
     if (bestMove.x == NONE){
       // Agent died, simulated game is complete
       break;
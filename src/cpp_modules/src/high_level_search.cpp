@@ -14,6 +14,11 @@ using namespace std;
  * The other elements can be anywhere.
  */
 void partiallySortPossibilityList(list<Possibility> &possibilityList, int keepTopN, OUT list<Possibility> &sortedList){
+  if (keepTopN <= 0) {
+    // There's no cutoff node to compare against, and the order doesn't matter
+    sortedList.insert(sortedList.end(), possibilityList.begin(), possibilityList.end());
+    return;
+  }
   auto cutoffPossibility = possibilityList.begin(); // The node on the "cutoff" between being in the top N placements and not
   int size = 0; // Tracking manually is cheaper than doing the O(n) operation each iteration
 
@@ -58,84 +63,144 @@ void partiallySortPossibilityList(list<Possibility> &possibilityList, int keepTo
  * @returns an UNSORTED list of evaluated possibilities
  */
 int searchDepth1(GameState gameState, const Piece *firstPiece, int keepTopN, const EvalContext *evalContext, OUT list<Possibility> &possibilityList){
-  vector<LockPlacement> firstLockPlacements;
-  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext.inputFrameTimeline, firstLockPlacements);
-  for (auto it = begin(firstLockPlacements); it != end(firstLockPlacements); ++it) {
-    LockPlacement firstPlacement = *it;
-
+  LockPlacementList firstLockPlacements;
+  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext, firstLockPlacements);
+  SurfaceFeatures surfaceFeatures = getSurfaceFeatures(gameState.surfaceArray, evalContext);
+
+  // Placements are evaluated in batches (see fastEvalBatch)
+  LockPlacement firstPlacements[EVAL_BATCH_SIZE];
+  GameState resultingStates[EVAL_BATCH_SIZE];
+  float evalScores[EVAL_BATCH_SIZE];
+  int batchSize = 0;
+  for (int i = 0; i < firstLockPlacements.size(); i++) {
+    LockPlacement firstPlacement = firstLockPlacements[i];
     GameState resultingState = advanceGameState(gameState, firstPlacement, evalContext);
-    if (SHOULD_PLAY_PERFECT && ((resultingState.lines - gameState.lines) % 4) != 0) {
-      continue; // While playing perfect, ignore any placements that burn lines
+    // While playing perfect, ignore any placements that burn lines
+    if (!SHOULD_PLAY_PERFECT || ((resultingState.lines - gameState.lines) % 4) == 0) {
+      firstPlacements[batchSize] = firstPlacement;
+      resultingStates[batchSize] = resultingState;
+      batchSize++;
+    }
+    bool isLastFirstPlacement = i == firstLockPlacements.size() - 1;
+    if (batchSize < EVAL_BATCH_SIZE && !isLastFirstPlacement) {
+      continue;
     }
-    float reward = getLineClearFactor(resultingState.lines - gameState.lines, evalContext->weights, evalContext->shouldRewardLineClears);
-    float evalScoreInclReward = fastEval(gameState, resultingState, firstPlacement, evalContext);
-
-    Possibility newPossibility = {
-      { firstPlacement.x, firstPlacement.y, firstPlacement.rotationIndex },
-      NULL_LOCK_LOCATION,
-      resultingState,
-      evalScoreInclReward,
-      reward
-    };
-    possibilityList.push_back(newPossibility);
+
+    fastEvalBatch(gameState, surfaceFeatures, resultingStates, firstPlacements, batchSize, evalContext, evalScores);
+    for (int b = 0; b < batchSize; b++) {
+      float reward = getLineClearFactor(resultingStates[b].lines - gameState.lines, evalContext->weights, evalContext->shouldRewardLineClears);
+      Possibility newPossibility = {
+        { firstPlacements[b].x, firstPlacements[b].y, firstPlacements[b].rotationIndex },
+        NULL_LOCK_LOCATION,
+        resultingStates[b],
+        evalScores[b],
+        reward
+      };
+      possibilityList.push_back(newPossibility);
+    }
+    batchSize = 0;
   }
   return (int) possibilityList.size();
 }
 
+// The second placements of a batch take up about 300KB, so each thread keeps them here rather than on the stack
+thread_local LockPlacementList secondLockPlacementsScratch[MOVE_SEARCH_BATCH_SIZE];
+
 /** Searches 2-ply from a starting state, and performs a fast eval on each of the resulting states. 
  * @returns an UNSORTED list of evaluated possibilities
  */
 int searchDepth2(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, const EvalContext *evalContext, OUT list<Possibility> &possibilityList){
 
   // Get the placements of the first piece
-  vector<LockPlacement> firstLockPlacements;
-  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext.inputFrameTimeline, firstLockPlacements);
-  for (auto it = begin(firstLockPlacements); it != end(firstLockPlacements); ++it) {
-    LockPlacement firstPlacement = *it;
+  LockPlacementList firstLockPlacements;
+  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext, firstLockPlacements);
+
+  // The second piece is searched on several of the boards after the first move at once (see moveSearchBatch)
+  LockPlacement firstPlacements[MOVE_SEARCH_BATCH_SIZE];
+  GameState afterFirstMoves[MOVE_SEARCH_BATCH_SIZE];
+  float firstMoveRewards[MOVE_SEARCH_BATCH_SIZE];
+  SurfaceFeatures afterFirstMoveSurfaceFeatures[MOVE_SEARCH_BATCH_SIZE];
+  LockPlacementList *secondLockPlacements = secondLockPlacementsScratch;
+  int batchSize = 0;
+
+  for (int i = 0; i < firstLockPlacements.size(); i++) {
+    LockPlacement firstPlacement = firstLockPlacements[i];
     maybePrint("\n\n\n\nNEW FIRST MOVE: rot=%d x=%d\n", firstPlacement.rotationIndex, firstPlacement.x);
 
     GameState afterFirstMove = advanceGameState(gameState, firstPlacement, evalContext);
-    if (SHOULD_PLAY_PERFECT && ((afterFirstMove.lines - gameState.lines) % 4) != 0) {
-      continue; // While playing perfect, ignore any placements that burn lines
-    }
-    for (int i = 0; i < 19; i++) {
-      maybePrint("%d ", (afterFirstMove.board[i] & ALL_TUCK_SETUP_BITS) >> 20);
+    // While playing perfect, ignore any placements that burn lines
+    bool isIgnored = SHOULD_PLAY_PERFECT && ((afterFirstMove.lines - gameState.lines) % 4) != 0;
+    if (!isIgnored) {
+      for (int row = 0; row < 19; row++) {
+        maybePrint("%d ", (afterFirstMove.board[row] & ALL_TUCK_SETUP_BITS) >> 20);
+      }
+      maybePrint("%d end of post first move\n", (afterFirstMove.board[19] & ALL_TUCK_SETUP_BITS) >> 20);
+      if (LOGGING_ENABLED) {
+        printBoard(afterFirstMove.board);
+      }
+
+      firstPlacements[batchSize] = firstPlacement;
+      afterFirstMoves[batchSize] = afterFirstMove;
+      firstMoveRewards[batchSize] = getLineClearFactor(afterFirstMove.lines - gameState.lines, evalContext->weights, evalContext->shouldRewardLineClears);
+      afterFirstMoveSurfaceFeatures[batchSize] = getSurfaceFeatures(afterFirstMove.surfaceArray, evalContext);
+      batchSize++;
     }
-    maybePrint("%d end of post first move\n", (afterFirstMove.board[19] & ALL_TUCK_SETUP_BITS) >> 20);
-    if (LOGGING_ENABLED) {
-      printBoard(afterFirstMove.board);
+    bool isLastFirstPlacement = i == firstLockPlacements.size() - 1;
+    if (batchSize < MOVE_SEARCH_BATCH_SIZE && !isLastFirstPlacement) {
+      continue;
     }
 
-    float firstMoveReward = getLineClearFactor(afterFirstMove.lines - gameState.lines, evalContext->weights, evalContext->shouldRewardLineClears);
-
     // Get the placements of the second piece
-    vector<LockPlacement> secondLockPlacements;
-    moveSearch(afterFirstMove, secondPiece, evalContext->pieceRangeContext.inputFrameTimeline, secondLockPlacements);
+    for (int b = 0; b < batchSize; b++) {
+      secondLockPlacements[b].clear();
+    }
+    moveSearchBatch(afterFirstMoves, batchSize, secondPiece, evalContext->pieceRangeContext, secondLockPlacements);
+
+    for (int b = 0; b < batchSize; b++) {
+      // The second placements are evaluated in batches too (see fastEvalBatch)
+      LockPlacementList const &secondPlacements = secondLockPlacements[b];
+      LockPlacement evalPlacements[EVAL_BATCH_SIZE];
+      GameState resultingStates[EVAL_BATCH_SIZE];
+      float evalScores[EVAL_BATCH_SIZE];
+      int evalBatchSize = 0;
+      for (int j = 0; j < secondPlacements.size(); j++) {
+        GameState resultingState = advanceGameState(afterFirstMoves[b], secondPlacements[j], evalContext);
+        // While playing perfect, ignore any placements that burn lines
+        if (!SHOULD_PLAY_PERFECT || ((resultingState.lines - afterFirstMoves[b].lines) % 4) == 0) {
+          evalPlacements[evalBatchSize] = secondPlacements[j];
+          resultingStates[evalBatchSize] = resultingState;
+          evalBatchSize++;
+        }
+        if (evalBatchSize < EVAL_BATCH_SIZE && j < secondPlacements.size() - 1) {
+          continue;
+        }
 
-    for (auto secondPlacement : secondLockPlacements) {
-      GameState resultingState = advanceGameState(afterFirstMove, secondPlacement, evalContext);
-      if (SHOULD_PLAY_PERFECT && ((resultingState.lines - afterFirstMove.lines) % 4) != 0) {
-        continue; // While playing perfect, ignore any placements that burn lines
+        fastEvalBatch(afterFirstMoves[b], afterFirstMoveSurfaceFeatures[b], resultingStates, evalPlacements, evalBatchSize, evalContext, evalScores);
+        for (int e = 0; e < evalBatchSize; e++) {
+          LockPlacement const &secondPlacement = evalPlacements[e];
+          float evalScore = firstMoveRewards[b] + evalScores[e];
+          float secondMoveReward = getLineClearFactor(resultingStates[e].lines - afterFirstMoves[b].lines, evalContext->weights, evalContext->shouldRewardLineClears);
+
+          Possibility newPossibility = {
+            { firstPlacements[b].x, firstPlacements[b].y, firstPlacements[b].rotationIndex },
+            { secondPlacement.x, secondPlacement.y, secondPlacement.rotationIndex },
+            resultingStates[e],
+            evalScore,
+            firstMoveRewards[b] + secondMoveReward
+          };
+
+          possibilityList.push_back(newPossibility);
+        }
+        evalBatchSize = 0;
       }
-      float evalScore = firstMoveReward + fastEval(afterFirstMove, resultingState, secondPlacement, evalContext);
-      float secondMoveReward = getLineClearFactor(resultingState.lines - afterFirstMove.lines, evalContext->weights, evalContext->shouldRewardLineClears);
-
-      Possibility newPossibility = {
-        { firstPlacement.x, firstPlacement.y, firstPlacement.rotationIndex },
-        { secondPlacement.x, secondPlacement.y, secondPlacement.rotationIndex },
-        resultingState,
-        evalScore,
-        firstMoveReward + secondMoveReward
-      };
-
-      possibilityList.push_back(newPossibility);
     }
+    batchSize = 0;
   }
   return (int) possibilityList.size();
 }
 
 /** Plays one move from a given state, with or without knowledge of the next box.*/
-LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup, PlayoutBudget playoutBudget){
   // Get the list of evaluated possibilities
   list<Possibility> possibilityList;
   list<Possibility> sortedList;
@@ -160,23 +225,47 @@ LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Pie
     return (*sortedList.begin()).firstPlacement;
   }
 
-  LockLocation bestLockLocation = {NONE, NONE, NONE};
-  float bestPossibilityScore = FLOAT_MIN;
-  int numPlayedOut = 0;
+  // Play out all the candidates at once, so that they can be spread across threads
+  vector<Possibility> candidates;
+  vector<GameState> candidateStates;
+  vector<float> immediateRewards;
   for (auto possibility : sortedList){
-    if (numPlayedOut >= numCandidatesToPlayout) {
+    if ((int) candidates.size() >= numCandidatesToPlayout) {
       break;
     }
-    float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, /* playoutDataList */ NULL);
+    candidates.push_back(possibility);
+    candidateStates.push_back(possibility.resultingState);
+    immediateRewards.push_back(possibility.immediateReward);
+  }
+  vector<float> playoutScores(candidates.size());
+  vector<int> playoutCounts(candidates.size(), playoutCount);
+  if (playoutBudget == SUCCESSIVE_HALVING) {
+    getPlayoutScoresAdaptive(candidateStates.data(), immediateRewards.data(), candidates.size(), playoutCount, playoutLength, evalContextLookup, lastSeenPiece->index, playoutScores.data(), playoutCounts.data());
+  } else if (playoutBudget == BOUND_PRUNING) {
+    getPlayoutScoresPruned(candidateStates.data(), immediateRewards.data(), candidates.size(), playoutCount, playoutLength, evalContextLookup, lastSeenPiece->index, playoutScores.data(), playoutCounts.data());
+  } else {
+    getPlayoutScores(candidateStates.data(), candidates.size(), playoutCount, playoutLength, evalContextLookup, lastSeenPiece->index, /* playoutDataLists */ NULL, playoutScores.data());
+  }
+  // Only the candidates that made it through every round are compared, since the others were dropped on fewer playouts
+  // (or, when pruning, were found to be unable to win)
+  int mostPlayouts = playoutCounts.empty() ? 0 : *std::max_element(playoutCounts.begin(), playoutCounts.end());
+
+  LockLocation bestLockLocation = {NONE, NONE, NONE};
+  float bestPossibilityScore = FLOAT_MIN;
+  for (int i = 0; i < (int) candidates.size(); i++){
+    Possibility const &possibility = candidates[i];
+    float overallScore = possibility.immediateReward + playoutScores[i];
 
-    maybePrint("Possibility %d %d has overallscore %f %f\n", possibility.firstPlacement.rotationIndex, possibility.firstPlacement.x - 3, overallScore, possibility.evalScoreInclReward);
+    maybePrint("Possibility %d %d has overallscore %f %f (%d playouts)\n", possibility.firstPlacement.rotationIndex, possibility.firstPlacement.x - 3, overallScore, possibility.evalScoreInclReward, playoutCounts[i]);
 
     // Potentially update the best possibility
+    if (playoutCounts[i] < mostPlayouts) {
+      continue;
+    }
     if (bestLockLocation.x == NONE || overallScore > bestPossibilityScore) {
       bestLockLocation = possibility.firstPlacement;
       bestPossibilityScore = overallScore;
     }
-    numPlayedOut++;
   }
 
   if (SHOULD_PLAY_PERFECT && bestPossibilityScore < 0.0001){
@@ -210,7 +299,7 @@ Possibility findPlayerMove(list<Possibility> possibilityList, unsigned int playe
   return {NULL_LOCK_LOCATION,NULL_LOCK_LOCATION,{}, -1, -1 /* rest default initializer */};
 }
 
-std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, unsigned int playerBoardAfter[20], int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, unsigned int playerBoardAfter[20], int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup){
   list<Possibility> possibilityListD1;
   list<Possibility> possibilityListD2;
   list<Possibility> sortedListD1; // Does not include player move
@@ -269,7 +358,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
   // PLAYOUTS NEEDED
   else {
     // NNB Playouts (first on the player move, then on the rest)
-    playerValNoAdj = playerMove.immediateReward + getPlayoutScore(playerMove.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, firstPiece->index, /* playoutDataList */ NULL);
+    playerValNoAdj = playerMove.immediateReward + getPlayoutScore(playerMove.resultingState, playoutCount, playoutLength, evalContextLookup, firstPiece->index, /* playoutDataList */ NULL);
     
     bestValNoAdj = playerValNoAdj;
     int numPlayedOut = 0;
@@ -277,7 +366,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
       if (numPlayedOut >= numCandidatesToPlayout) {
         break;
       }
-      float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, firstPiece->index, /* playoutDataList */ NULL);
+      float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, evalContextLookup, firstPiece->index, /* playoutDataList */ NULL);
       if (overallScore > bestValNoAdj) {
         bestValNoAdj = overallScore;
       }
@@ -295,7 +384,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
         if (numPlayedOut >= numCandidatesToPlayout && !playerValUnset) {
           break;
         }
-        float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, secondPiece->index, /* playoutDataList */ NULL);
+        float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, evalContextLookup, secondPiece->index, /* playoutDataList */ NULL);
         if (bestValUnset || overallScore > bestValAfterAdj) {
           bestValUnset = false;
           bestValAfterAdj = overallScore;
@@ -316,7 +405,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
 /**
  * Gets a list of the top moves, formatted as a JSON string. (See formatting.hpp for exact format details).
  */
-std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup){
   // Keep a running list of the top X possibilities as the move search is happening.
   // Keep twice as many as we'll eventually need, since some duplicates may be removed before playouts start
   int numSorted = keepTopN * 2;
@@ -342,40 +431,51 @@ std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const P
   }
   partiallySortPossibilityList(possibilityList, numSorted, initiallySortedList);
 
-  // Perform playouts on the promising possibilities
+  // Perform playouts on the promising possibilities. The ones that are still needed are played out together so that
+  // they can be spread across threads, and then added in order. Some may have no legal playouts, in which case the
+  // next ones down the list are played out too.
+  vector<Possibility> candidates(initiallySortedList.begin(), initiallySortedList.end());
   int numAdded = 0;
-  for (Possibility const& possibility : initiallySortedList) {
-    if (numAdded >= keepTopN){
-      break;
+  int nextCandidate = 0;
+  while (numAdded < keepTopN && nextCandidate < (int) candidates.size()) {
+    int numToPlayOut = min(keepTopN - numAdded, (int) candidates.size() - nextCandidate);
+    vector<GameState> candidateStates;
+    for (int i = nextCandidate; i < nextCandidate + numToPlayOut; i++) {
+      candidateStates.push_back(candidates[i].resultingState);
     }
-    // printf("Doing playout for: %s %s\n", encodeLockPosition(possibility.firstPlacement).c_str(), encodeLockPosition(possibility.secondPlacement).c_str());
-    string lockPosEncoded = encodeLockPosition(possibility.firstPlacement);
-    vector<PlayoutData> playoutDataList = {};
-    float overallScore = possibility.immediateReward 
-          + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, &playoutDataList);
-
-    // If this position has no legal playouts, ignore it
-    if (playoutDataList.size() == 0){
-      continue;
+    vector<vector<PlayoutData>> playoutDataLists(numToPlayOut);
+    vector<float> playoutScores(numToPlayOut);
+    getPlayoutScores(candidateStates.data(), numToPlayOut, playoutCount, playoutLength, evalContextLookup, lastSeenPiece->index, playoutDataLists.data(), playoutScores.data());
+
+    for (int i = 0; i < numToPlayOut; i++) {
+      Possibility const &possibility = candidates[nextCandidate + i];
+      vector<PlayoutData> const &playoutDataList = playoutDataLists[i];
+      float overallScore = possibility.immediateReward + playoutScores[i];
+
+      // If this position has no legal playouts, ignore it
+      if (playoutDataList.size() == 0){
+        continue;
+      }
+      // Pick 7 playouts from the sorted playout list
+      int len = (int) playoutDataList.size();
+      EngineMoveData newMoveData = {
+        possibility.firstPlacement,
+        possibility.secondPlacement,
+        /* playoutScore */ overallScore,
+        /* shallowEvalScore */ possibility.evalScoreInclReward,
+        /* resultingBoard */ formatBoard(possibility.resultingState.board),
+        /* playout1 (best case) */ playoutDataList.at(0),
+        /* playout2 (83 %ile case) */ playoutDataList.at(len / 6), // Fractions are "backwards" because moves are ordered best (100%ile) to worst (0%ile).
+        /* playout3 (66 %ile case) */ playoutDataList.at(len / 3),
+        /* playout4 (median case) */ playoutDataList.at(len / 2),
+        /* playout5 (33 %ile case) */ playoutDataList.at(len * 2 / 3),
+        /* playout6 (16 %ile case) */ playoutDataList.at(len * 5 / 6),
+        /* playout7 (worst case) */ playoutDataList.at(len - 1),
+      };
+      insertIntoList(newMoveData, sortedList);
+      numAdded++;
     }
-    // Pick 7 playouts from the sorted playout list
-    int len = (int) playoutDataList.size();
-    EngineMoveData newMoveData = {
-      possibility.firstPlacement,
-      possibility.secondPlacement,
-      /* playoutScore */ overallScore,
-      /* shallowEvalScore */ possibility.evalScoreInclReward,
-      /* resultingBoard */ formatBoard(possibility.resultingState.board),
-      /* playout1 (best case) */ playoutDataList.at(0),
-      /* playout2 (83 %ile case) */ playoutDataList.at(len / 6), // Fractions are "backwards" because moves are ordered best (100%ile) to worst (0%ile).
-      /* playout3 (66 %ile case) */ playoutDataList.at(len / 3),
-      /* playout4 (median case) */ playoutDataList.at(len / 2),
-      /* playout5 (33 %ile case) */ playoutDataList.at(len * 2 / 3),
-      /* playout6 (16 %ile case) */ playoutDataList.at(len * 5 / 6),
-      /* playout7 (worst case) */ playoutDataList.at(len - 1),
-    };
-    insertIntoList(newMoveData, sortedList);
-    numAdded++;
+    nextCandidate += numToPlayOut;
   }
 
   return formatEngineMoveList(sortedList, firstPiece, secondPiece);
@@ -385,8 +485,11 @@ std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const P
 
 /** Calculates the valuation of every possible terminal position for a given piece on a given board, and stores it in a map.
  * @param keepTopN - How many possibilities to evaluate via a full set of playouts, as opposed to just the eval function.
+ * @param playoutBudget - with successive halving, positions that were dropped before the last round get the same value
+ * as the ones that weren't played out, since their playout score is only a partial mean. The playout counts are only
+ * logged, so that the map keeps one entry per lock position.
  */
-std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup, PlayoutBudget playoutBudget){
   unordered_map<string, float> lockValueMap;
   unordered_map<string, int> lockValueRepeatMap;
 
@@ -410,10 +513,14 @@ std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPie
       }
     }
   } else {
-    // Perform playouts on the promising possibilities
+    // Pick which possibilities to perform playouts on. That only depends on their order, so it's done up front and
+    // all the playouts can then be spread across threads together.
     int i = 0;
     int numPlayedOut = 0;
     int firstPlacementRepeatCap = floor(LOCK_POSITION_REPEAT_CAP_PROPORTION * keepTopN);
+    vector<int> shouldPlayoutList;
+    vector<GameState> candidateStates;
+    vector<float> immediateRewards;
     for (Possibility const& possibility : sortedList) {
       string lockPosEncoded = encodeLockPosition(possibility.firstPlacement);
       // Cap the number of times a lock position can be repeated (despite differing second placements)
@@ -422,27 +529,57 @@ std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPie
         printf("\n----%s, repeats %d, willPlay %d\n", lockPosEncoded.c_str(), lockValueRepeatMap[lockPosEncoded], shouldPlayout);
       }
       lockValueRepeatMap[lockPosEncoded] += 1;
+      shouldPlayoutList.push_back(shouldPlayout);
+      if (shouldPlayout) {
+        candidateStates.push_back(possibility.resultingState);
+        immediateRewards.push_back(possibility.immediateReward);
+      }
+      i++;
+      if (shouldPlayout) {
+        numPlayedOut++;
+      }
+    }
+    vector<float> playoutScores(candidateStates.size());
+    vector<int> playoutCounts(candidateStates.size(), playoutCount);
+    if (playoutBudget == SUCCESSIVE_HALVING) {
+      getPlayoutScoresAdaptive(candidateStates.data(), immediateRewards.data(), candidateStates.size(), playoutCount, playoutLength, evalContextLookup, secondPiece->index, playoutScores.data(), playoutCounts.data());
+    } else {
+      getPlayoutScores(candidateStates.data(), candidateStates.size(), playoutCount, playoutLength, evalContextLookup, secondPiece->index, /* playoutDataLists */ NULL, playoutScores.data());
+    }
+    // Only the candidates that made it through every round have a final score
+    int mostPlayouts = playoutCounts.empty() ? 0 : *std::max_element(playoutCounts.begin(), playoutCounts.end());
 
-      float overallScore = MAP_OFFSET + (shouldPlayout
-         ? possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, secondPiece->index, /* playoutDataList */ NULL)
+    // Perform playouts on the promising possibilities
+    i = 0;
+    int candidateIndex = 0;
+    for (Possibility const& possibility : sortedList) {
+      string lockPosEncoded = encodeLockPosition(possibility.firstPlacement);
+      int shouldPlayout = shouldPlayoutList[i];
+      int numPlayouts = 0;
+      float playoutScore = 0;
+      if (shouldPlayout) {
+        numPlayouts = playoutCounts[candidateIndex];
+        playoutScore = playoutScores[candidateIndex];
+        candidateIndex++;
+      }
+      bool hasFinalScore = shouldPlayout && numPlayouts == mostPlayouts;
+      float overallScore = MAP_OFFSET + (hasFinalScore
+         ? possibility.immediateReward + playoutScore
          : (SHOULD_PLAY_PERFECT ? 0 : evalContext->weights.deathCoef));
       
       if (overallScore > lockValueMap[lockPosEncoded]) {
         if (PLAYOUT_LOGGING_ENABLED || PLAYOUT_RESULT_LOGGING_ENABLED) {
-          if (shouldPlayout) {
-            printf("Adding to map: %s %f (%f + %f)\n", lockPosEncoded.c_str(), overallScore - MAP_OFFSET, possibility.immediateReward, overallScore - possibility.immediateReward - MAP_OFFSET);
+          if (hasFinalScore) {
+            printf("Adding to map: %s %f (%f + %f, %d playouts)\n", lockPosEncoded.c_str(), overallScore - MAP_OFFSET, possibility.immediateReward, overallScore - possibility.immediateReward - MAP_OFFSET, numPlayouts);
           }
         }
         lockValueMap[lockPosEncoded] = overallScore;
       } else if (PLAYOUT_LOGGING_ENABLED || PLAYOUT_RESULT_LOGGING_ENABLED) {
         if (shouldPlayout) {
-          printf("Score of %.1f is worse than existing move %.1f\n", overallScore, lockValueMap[lockPosEncoded]);
+          printf("Score of %.1f (%d playouts) is worse than existing move %.1f\n", overallScore, numPlayouts, lockValueMap[lockPosEncoded]);
         }
       }
       i++;
-      if (shouldPlayout) {
-        numPlayedOut++;
-      }
     }
   }
 
@@ -6,10 +6,10 @@
 #include <list>
 #include <algorithm>
 
-LockLocation playOneMove(GameState gameState, const Piece *curPiece, const Piece *nextPiece, int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
+LockLocation playOneMove(GameState gameState, const Piece *curPiece, const Piece *nextPiece, int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup, PlayoutBudget playoutBudget);
 
-std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
+std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup);
 
-std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
+std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, EvalContextLookup const &evalContextLookup, PlayoutBudget playoutBudget);
 
 #endif
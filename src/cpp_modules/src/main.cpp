@@ -3,6 +3,7 @@
 #include <stdlib.h>     /* srand, rand */
 #include <time.h>       /* time */
 #include <string.h>
+#include <memory>
 
 
 #include "params.hpp"
@@ -13,12 +14,14 @@
 #include "eval_context.cpp"
 #include "move_result.cpp"
 #include "move_search.cpp"
+#include "flood_fill_search.cpp"
 #include "piece_ranges.cpp"
 #include "playout.cpp"
 #include "high_level_search.cpp"
 #include "piece_rng.cpp"
+#include "surface_ranks.cpp"
+#include "thread_pool.cpp"
 // #include "../data/ranks_output.cpp"
-#include "../data/ranks_base_7.cpp"
 
 template<typename ... Args>
 std::string string_format( const std::string& format, Args ... args )
@@ -34,6 +37,11 @@ std::string string_format( const std::string& format, Args ... args )
     return std::string( buf.get(), buf.get() + size - 1 ); // We don't want the '\0' inside
 }
 
+/** Gets the engine's internal performance counters, formatted as JSON. */
+std::string getEngineStats() {
+  return "{\"moveSearchCache\":" + getMoveSearchCacheStats() + ",\"evalCache\":" + getEvalCacheStats() + "}";
+}
+
 std::string mainProcess(char const *inputStr, RequestType requestType) {
   maybePrint("Input string %s\n", inputStr);
 
@@ -52,6 +60,8 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
   int playoutCount = DEFAULT_PLAYOUT_COUNT;
   int playoutLength = DEFAULT_PLAYOUT_LENGTH;
   int pruningBreadth = DEFAULT_PRUNING_BREADTH;
+  MoveSearchEngine moveSearchEngine = DEFAULT_MOVE_SEARCH_ENGINE;
+  PlayoutBudget playoutBudget = DEFAULT_PLAYOUT_BUDGET;
   std::string inputFrameTimeline;
 
   // Loop through the other args
@@ -103,6 +113,13 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
       break;
     case 7:
       pruningBreadth = argAsInt;
+      break;
+    case 8:
+      moveSearchEngine = argAsInt == 1 ? FLOOD_FILL : FRAME_SIMULATION;
+      break;
+    case 9:
+      playoutBudget = argAsInt == 1 ? SUCCESSIVE_HALVING : argAsInt == 2 ? BOUND_PRUNING : FIXED_PLAYOUT_BUDGET;
+      break;
     default:
       break;
     }
@@ -122,13 +139,19 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
   startingGameState.numPartialHoles = result.second;
 
   // Calculate global context for the 3 possible gravity values
+  if (!isValidInputTimeline(inputFrameTimeline.c_str())){
+    return "Error: invalid input frame timeline.";
+  }
+  const InputTimeline inputTimeline = compileInputTimeline(inputFrameTimeline.c_str());
   const PieceRangeContext pieceRangeContextLookup[4] = {
-    getPieceRangeContext(inputFrameTimeline.c_str(), 1, /* gravityDoubled= */ true),
-    getPieceRangeContext(inputFrameTimeline.c_str(), 1, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline.c_str(), 2, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline.c_str(), 3, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, moveSearchEngine, 1, /* gravityDoubled= */ true),
+    getPieceRangeContext(inputTimeline, moveSearchEngine, 1, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, moveSearchEngine, 2, /* gravityDoubled= */ false),
+    getPieceRangeContext(inputTimeline, moveSearchEngine, 3, /* gravityDoubled= */ false),
   };
-  const EvalContext context = getEvalContext(startingGameState, pieceRangeContextLookup);
+  EvalContextLookup evalContextLookup;
+  buildEvalContextLookup(pieceRangeContextLookup, evalContextLookup);
+  const EvalContext context = *lookUpEvalContext(startingGameState, evalContextLookup);
 
   // Recalculate holes once we have the eval context
   pair<int, float> result2 = updateSurfaceAndHoles(startingGameState.surfaceArray, startingGameState.board, context.countWellHoles ? -1 : context.wellColumn, context.aiMode == DIG);
@@ -143,25 +166,25 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
   // Take the specified action on the input based on the request type
   switch (requestType) {
     case GET_LOCK_VALUE_LOOKUP: {
-      return getLockValueLookupEncoded(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      return getLockValueLookupEncoded(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, evalContextLookup, playoutBudget);
     }
 
     case GET_TOP_MOVES: {
-      return getTopMoveList(startingGameState, curPiece, nextPiece, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      return getTopMoveList(startingGameState, curPiece, nextPiece, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, evalContextLookup);
     }
 
     case GET_TOP_MOVES_HYBRID: {
-      std::string nnbResult = getTopMoveList(startingGameState, curPiece, /* nextPiece= */ NULL, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, pieceRangeContextLookup);
-      std::string nbResult = getTopMoveList(startingGameState, curPiece, nextPiece, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      std::string nnbResult = getTopMoveList(startingGameState, curPiece, /* nextPiece= */ NULL, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, evalContextLookup);
+      std::string nbResult = getTopMoveList(startingGameState, curPiece, nextPiece, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, evalContextLookup);
       return "{\"noNextBox\":" + nnbResult + ", \"nextBox\":" + nbResult + "}";
     }
 
     case RATE_MOVE: {
-      return rateMove(startingGameState, curPiece, nextPiece, secondBoard, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      return rateMove(startingGameState, curPiece, nextPiece, secondBoard, pruningBreadth, playoutCount, playoutLength, &context, evalContextLookup);
     }
 
     case GET_MOVE: {
-      LockLocation bestMove = playOneMove(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      LockLocation bestMove = playOneMove(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, evalContextLookup, playoutBudget);
       int xOffset = bestMove.x - 3;
       int rot = bestMove.rotationIndex;
       int yOffset = bestMove.y - curPiece->initialY;
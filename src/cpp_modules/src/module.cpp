@@ -74,7 +74,42 @@ NAN_METHOD(RateMove) {
   info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
 }
 
+NAN_METHOD(LoadSurfaceRanks) {
+  // Parse string arg
+  Nan::MaybeLocal<String> maybeStr = Nan::To<String>(info[0]);
+  v8::Local<String> pathNan;
+  if (maybeStr.ToLocal(&pathNan) == false) {
+    Nan::ThrowError("Error converting first argument to string");
+  }
+  std::string error = loadSurfaceRanks(*Nan::Utf8String(pathNan));
+  if (!error.empty()) {
+    Nan::ThrowError(error.c_str());
+  }
+}
+
+NAN_METHOD(SetThreadCount) {
+  Nan::Maybe<int> maybeNumThreads = Nan::To<int>(info[0]);
+  if (maybeNumThreads.IsNothing()) {
+    Nan::ThrowError("Error converting first argument to int");
+    return;
+  }
+  setThreadCount(maybeNumThreads.FromJust());
+}
+
+NAN_METHOD(GetEngineStats) {
+  std::string result = getEngineStats();
+
+  info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
+}
+
 NAN_MODULE_INIT(Init) {
+  // The module still loads without the default ranks, since a different set can be loaded (or the eval falls back to
+  // flatness), but it's worth knowing about
+  std::string ranksError = loadSurfaceRanks(DEFAULT_SURFACE_RANKS_PATH);
+  if (!ranksError.empty()) {
+    printf("Warning: %s. Falling back to flatness until loadSurfaceRanks is called.\n", ranksError.c_str());
+  }
+
   Nan::Set(target, Nan::New("getLockValueLookup").ToLocalChecked(),
            Nan::GetFunction(Nan::New<FunctionTemplate>(GetLockValueLookup)).ToLocalChecked());
   Nan::Set(target, Nan::New("getMove").ToLocalChecked(),
@@ -85,6 +120,12 @@ NAN_MODULE_INIT(Init) {
            Nan::GetFunction(Nan::New<FunctionTemplate>(GetTopMovesHybrid)).ToLocalChecked());
   Nan::Set(target, Nan::New("rateMove").ToLocalChecked(),
            Nan::GetFunction(Nan::New<FunctionTemplate>(RateMove)).ToLocalChecked());
+  Nan::Set(target, Nan::New("loadSurfaceRanks").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(LoadSurfaceRanks)).ToLocalChecked());
+  Nan::Set(target, Nan::New("setThreadCount").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(SetThreadCount)).ToLocalChecked());
+  Nan::Set(target, Nan::New("getEngineStats").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(GetEngineStats)).ToLocalChecked());
 }
 
 NODE_MODULE(myaddon, Init)
@@ -1,7 +1,127 @@
 #include "move_result.hpp"
+#include <array>
 #include <stdexcept>
 #include <utility>
 
+/*
+ * Tuck setups are classified with a lookup table instead of checking each kind of setup in turn. Every setup to the left
+ * of a cell depends only on:
+ *  - which of the 5 cells from the cell leftwards are empty in its row (cells past the wall count as filled)
+ *  - how the surface 1 column to the left compares to the cell (below, level with the bottom of the cell, or above)
+ *  - whether each of the surfaces 1-4 columns to the left equals the next one, and whether the one 2 to the left is at or below the bottom of the cell
+ *  - whether it's dig mode
+ * and likewise for setups to the right. The table stores which kind of setup it is (see TUCK_SETUP_RATINGS), or 0 for none.
+ */
+#define TUCK_SETUP_KEY_RANGE (1 << 12)
+
+enum TuckSetupType {
+  NO_TUCK_SETUP,
+  LEFT_1_HIGH_AMPLE_SPACE,
+  LEFT_1_HIGH_SOME_SPACE,
+  LEFT_RAISED,
+  LEFT_MINIMAL_SPACE,
+  RIGHT_1_HIGH_AMPLE_SPACE,
+  RIGHT_1_HIGH_SOME_SPACE,
+  RIGHT_RAISED,
+  RIGHT_MINIMAL_SPACE
+};
+
+const float TUCK_SETUP_RATINGS[9] = {
+  0,
+  0.2f, // Left side 1-high tuck, with ample space = 4+ pieces solve.
+  0.35f, // Left side 1-high tuck, with some space = generally 3+ pieces solve.
+  0.5f, // Left side tuck raised off the ground, with some space = generally 2 pieces solve.
+  0.75f, // Left side tuck, with minimal space = generally 1-piece solve.
+  0.1875, // Right side 1-high tuck, with ample space = 4+ piece solve
+  0.325f, // Right side 1-high tuck, with some space = generally 3+ pieces solve.
+  0.45f, // Right side tuck raised off the ground, with some space = generally 2 pieces solve.
+  0.65f, // Right side tuck, with minimal space = 1-piece solve + spin option.
+};
+
+#define SURFACE_BELOW 0
+#define SURFACE_LEVEL 1
+#define SURFACE_ABOVE 2
+
+/**
+ * Packs the features that a tuck setup on one side depends on into a table key.
+ * @param cellBits - which of the 5 cells from the hole towards that side are filled (see getTuckSetupTable)
+ * @param nearSurfaces - the surface heights 1-4 columns away (towards that side)
+ */
+int getTuckSetupKey(unsigned int cellBits, int nearSurfaces[4], int cellHeight, bool isDigMode) {
+  int surfaceVsCell = nearSurfaces[0] < cellHeight ? SURFACE_BELOW : (nearSurfaces[0] == cellHeight ? SURFACE_LEVEL : SURFACE_ABOVE);
+  return cellBits
+         | surfaceVsCell << 5
+         | (nearSurfaces[1] == nearSurfaces[0]) << 7
+         | (nearSurfaces[2] == nearSurfaces[1]) << 8
+         | (nearSurfaces[3] == nearSurfaces[2]) << 9
+         | (nearSurfaces[1] <= cellHeight) << 10
+         | isDigMode << 11;
+}
+
+/**
+ * Builds the lookup table for tuck setups on one side of a cell. The left and right setups are mirror images, apart from their ratings.
+ * In the keys for the right side, the cell bits are in board order (bit 4 - N is column c + N), so they don't need reversing at lookup time.
+ */
+array<unsigned char, TUCK_SETUP_KEY_RANGE> getTuckSetupTable(bool isRightSide) {
+  array<unsigned char, TUCK_SETUP_KEY_RANGE> table = {};
+  for (int key = 0; key < TUCK_SETUP_KEY_RANGE; key++) {
+    // Bit N is the cell N columns away from the hole
+    unsigned int cellBits = 0;
+    for (int i = 0; i < 5; i++) {
+      cellBits |= ((key >> (isRightSide ? 4 - i : i)) & 1) << i;
+    }
+    int surfaceVsCell = (key >> 5) & 0b11;
+    bool isFlat1 = (key >> 7) & 1; // Whether the surfaces 1 and 2 columns away are equal
+    bool isFlat2 = (key >> 8) & 1;
+    bool isFlat3 = (key >> 9) & 1;
+    bool isSecondSurfaceBelowCell = (key >> 10) & 1;
+    bool isDigMode = (key >> 11) & 1;
+    int typeOffset = isRightSide ? RIGHT_1_HIGH_AMPLE_SPACE - LEFT_1_HIGH_AMPLE_SPACE : 0;
+
+    if ((cellBits & 0b11111) == 0 && surfaceVsCell == SURFACE_LEVEL && isFlat1 && isFlat2 && isFlat3) {
+      table[key] = LEFT_1_HIGH_AMPLE_SPACE + typeOffset;
+    } else if ((cellBits & 0b1111) == 0 && surfaceVsCell == SURFACE_LEVEL && isFlat1 && isFlat2) {
+      table[key] = LEFT_1_HIGH_SOME_SPACE + typeOffset;
+    } else if (!isDigMode && (cellBits & 0b1111) == 0 && surfaceVsCell == SURFACE_BELOW && isFlat1 && isFlat2) {
+      table[key] = LEFT_RAISED + typeOffset;
+    } else if (!isDigMode && (cellBits & 0b111) == 0 && surfaceVsCell != SURFACE_ABOVE && isSecondSurfaceBelowCell) {
+      table[key] = LEFT_MINIMAL_SPACE + typeOffset;
+    }
+  }
+  return table;
+}
+
+const array<unsigned char, TUCK_SETUP_KEY_RANGE> LEFT_TUCK_SETUP_TABLE = getTuckSetupTable(/* isRightSide= */ false);
+const array<unsigned char, TUCK_SETUP_KEY_RANGE> RIGHT_TUCK_SETUP_TABLE = getTuckSetupTable(/* isRightSide= */ true);
+
+/** Looks up which kind of tuck setup (if any) an empty cell is, checking the left side first. */
+int getTuckSetupType(unsigned int board[20], int r, int c, int surfaceArray[10], bool isDigMode) {
+  // Pad the row with walls on both sides, such that column x is at bit (13 - x)
+  unsigned int paddedRow = (0b1111U << 14) | ((board[r] & FULL_ROW) << 4) | 0b1111U;
+  // The height of the bottom of the cell, i.e. the surface height of a column that's filled up to just below it
+  int cellHeight = 19 - r;
+
+  // Every setup needs the cell next to the hole to be open, which rules out most holes without reading any surfaces
+  // Bit N is column c - N
+  unsigned int leftCellBits = (paddedRow >> (13 - c)) & 0b11111;
+  if (!(leftCellBits & 0b10)) {
+    // Surfaces past the wall are never read from the table, since those cells are filled
+    int leftSurfaces[4] = {surfaceArray[c - 1], surfaceArray[max(c - 2, 0)], surfaceArray[max(c - 3, 0)], surfaceArray[max(c - 4, 0)]};
+    int type = LEFT_TUCK_SETUP_TABLE[getTuckSetupKey(leftCellBits, leftSurfaces, cellHeight, isDigMode)];
+    if (type != NO_TUCK_SETUP) {
+      return type;
+    }
+  }
+
+  // Bit 4 - N is column c + N
+  unsigned int rightCellBits = (paddedRow >> (9 - c)) & 0b11111;
+  if (!(rightCellBits & 0b01000)) {
+    int rightSurfaces[4] = {surfaceArray[c + 1], surfaceArray[min(c + 2, 9)], surfaceArray[min(c + 3, 9)], surfaceArray[min(c + 4, 9)]};
+    return RIGHT_TUCK_SETUP_TABLE[getTuckSetupKey(rightCellBits, rightSurfaces, cellHeight, isDigMode)];
+  }
+  return NO_TUCK_SETUP;
+}
+
 /**
  * Rates a hole from 0 to 1 based on how bad it is.
  * Ignore all but the most permissible of tuck setups while digging.
@@ -13,69 +133,10 @@ float analyzeHole(unsigned int board[20], int r, int c, int excludeHolesColumn,
     printf("PANIK B, r=%d\n", r);
   }
   if (CAN_TUCK){
-    if (c >= 4 
-        && ((board[r] >> (9-c)) & 0b11111) == 0
-        && (20 - surfaceArray[c-1] == r+1)
-        && (surfaceArray[c-2] == surfaceArray[c-1])
-        && (surfaceArray[c-3] == surfaceArray[c-2])
-        && (surfaceArray[c-4] == surfaceArray[c-3])){
+    int tuckSetupType = getTuckSetupType(board, r, c, surfaceArray, isDigMode);
+    if (tuckSetupType != NO_TUCK_SETUP) {
       board[r] |= TUCK_SETUP_BIT(c); // Mark this cell as an overhang cell
-      return 0.2f; // Left side 1-high tuck, with ample space = 4+ pieces solve.
-    }
-    if (c >= 3 
-        && ((board[r] >> (9-c)) & 0b1111) == 0
-        && (20 - surfaceArray[c-1] == r+1)
-        && (surfaceArray[c-2] == surfaceArray[c-1])
-        && (surfaceArray[c-3] == surfaceArray[c-2])){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.35f; // Left side 1-high tuck, with some space = generally 3+ pieces solve.
-    }
-    if (!isDigMode && c >= 3 
-        && ((board[r] >> (9-c)) & 0b1111) == 0
-        && (20 - surfaceArray[c-1] > r+1)
-        && (surfaceArray[c-2] == surfaceArray[c-1])
-        && (surfaceArray[c-3] == surfaceArray[c-2])){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.5f; // Left side tuck raised off the ground, with some space = generally 2 pieces solve.
-    }
-    if (!isDigMode && c >= 2
-        && ((board[r] >> (9-c)) & 0b111) == 0
-        && (20 - surfaceArray[c-1] >= r+1)
-        && (20 - surfaceArray[c-2] >= r+1)){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.75f; // Left side tuck, with minimal space = generally 1-piece solve.
-    }
-    if (c <= 5 
-        && ((board[r] >> (5-c)) & 0b11111) == 0
-        && (20 - surfaceArray[c+1] == r+1)
-        && (surfaceArray[c+2] == surfaceArray[c+1])
-        && (surfaceArray[c+3] == surfaceArray[c+2])
-        && (surfaceArray[c+4] == surfaceArray[c+3])){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.1875; // Right side 1-high tuck, with ample space = 4+ piece solve
-    }
-    if (c <= 6 
-        && ((board[r] >> (6-c)) & 0b1111) == 0
-        && (20 - surfaceArray[c+1] == r+1)
-        && (surfaceArray[c+2] == surfaceArray[c+1])
-        && (surfaceArray[c+3] == surfaceArray[c+2])){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.325f; // Right side 1-high tuck, with some space = generally 3+ pieces solve.
-    }
-    if (!isDigMode && c <= 6 
-        && ((board[r] >> (6-c)) & 0b1111) == 0
-        && (20 - surfaceArray[c+1] > r+1)
-        && (surfaceArray[c+2] == surfaceArray[c+1])
-        && (surfaceArray[c+3] == surfaceArray[c+2])){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.45f; // Right side tuck raised off the ground, with some space = generally 2 pieces solve.
-    }
-    if (!isDigMode && c <= 7
-        && ((board[r] >> (7-c)) & 0b111) == 0
-        && (20 - surfaceArray[c+1] >= r+1)
-        && (20 - surfaceArray[c+2] >= r+1)){
-      board[r] |= TUCK_SETUP_BIT(c);
-      return 0.65f; // Right side tuck, with minimal space = 1-piece solve + spin option.
+      return TUCK_SETUP_RATINGS[tuckSetupType];
     }
     if (!isDigMode && c == 8
         && r <= 16
@@ -203,6 +264,8 @@ std::pair<int, float> getNewSurfaceAndNumNewHoles(int surfaceArray[10],
 /**
  * Manually finds the surface heights and holes after lines have been cleared (since usual prediction tricks
  * don't apply).
+ * Works on whole rows at a time: a running OR of the rows (starting at each column's previous surface) finds the surface
+ * and every covered cell in all 10 columns at once, so only the covered cells need to be rated with analyzeHole.
  * @param excludeHolesColumn - a prespecified column to ignore holes in (usually the well). A value of -1 disables this behavior.
  * @returns the new hole count
  */
@@ -213,39 +276,76 @@ std::pair<int, float> updateSurfaceAndHoles(int surfaceArray[10], unsigned int b
   }
   int numTrueHoles = 0;
   float numPartialHoles = 0;
-  
-  // Calculate the new surface array first, since its value is used in subsequent calculations
+
+  // Calculate the new surface array first, since its value is used in subsequent calculations.
+  // Each column searches down for its first filled cell, starting from its previous surface.
+  unsigned int colsStartingSearchAtRow[20] = {};
   for (int c = 0; c < 10; c++) {
-    int mask = 1 << (9 - c);
     int r = 20 - surfaceArray[c];
-    while (r >= 0 && r < 20 && !(board[r] & mask)) {
-      r++;
+    if (r >= 0 && r < 20) {
+      colsStartingSearchAtRow[r] |= CELL_BIT(c);
     }
-    // Update the new surface array
-    surfaceArray[c] = 20 - r;
   }
-  
-  // Update hole and tuck setup info
+  unsigned int searchingCols = 0;
+  for (int r = 0; r < 20; r++) {
+    searchingCols |= colsStartingSearchAtRow[r];
+    unsigned int foundCols = searchingCols & board[r];
+    if (foundCols == 0) {
+      continue;
+    }
+    for (int c = 0; c < 10; c++) {
+      if (foundCols & CELL_BIT(c)) {
+        surfaceArray[c] = 20 - r;
+      }
+    }
+    searchingCols &= ~foundCols;
+  }
+  // Columns that never found a cell are empty
+  for (int c = 0; c < 10; c++) {
+    if (searchingCols & CELL_BIT(c)) {
+      surfaceArray[c] = 0;
+    }
+  }
+
+  // Find the empty cells at or below the surface of each column
+  unsigned int colsReachingRow[20] = {};
   for (int c = 0; c < 10; c++) {
-    int mask = 1 << (9 - c);
     int r = 20 - surfaceArray[c];
     // VARIABLE_RANGE_CHECKS
     r = max(0, r);
-    r = min(20, r);
+    if (r < 20) {
+      colsReachingRow[r] |= CELL_BIT(c);
+    }
+  }
+  unsigned int coveredColsByRow[20];
+  unsigned int belowSurfaceCols = 0;
+  for (int r = 0; r < 20; r++) {
+    belowSurfaceCols |= colsReachingRow[r];
+    coveredColsByRow[r] = belowSurfaceCols & ~board[r] & FULL_ROW;
+  }
+  // Turn that around into the covered rows of each column (bit r for row r), visiting only the covered cells
+  unsigned int coveredRowsByCol[10] = {};
+  for (int r = 0; r < 20; r++) {
+    for (unsigned int cols = coveredColsByRow[r]; cols != 0; cols &= cols - 1) {
+      coveredRowsByCol[9 - getLowestBitIndex(cols)] |= 1U << r;
+    }
+  }
+
+  // Update hole and tuck setup info. This goes column by column (top to bottom) so that the partial holes are added up
+  // in the same order as they always have been.
+  for (int c = 0; c < 10; c++) {
     int lowestHoleInCol = -1;
-    while (r < 20) {
+    for (unsigned int rows = coveredRowsByCol[c]; rows != 0; rows &= rows - 1) {
+      int r = getLowestBitIndex(rows);
       // Add new holes to the overall count, unless they're in the well
-      if (!(board[r] & mask)) {
-        float rating = analyzeHole(board, r, c, excludeHolesColumn, surfaceArray, isDigMode);
-        // Check that it's a hole (1.0) and not a tuck setup (eg. 0.9)
-        if (rating == 1){
-          lowestHoleInCol = r;
-          numTrueHoles += 1;
-        } else {
-          numPartialHoles += rating;
-        }
+      float rating = analyzeHole(board, r, c, excludeHolesColumn, surfaceArray, isDigMode);
+      // Check that it's a hole (1.0) and not a tuck setup (eg. 0.9)
+      if (rating == 1){
+        lowestHoleInCol = r;
+        numTrueHoles += 1;
+      } else {
+        numPartialHoles += rating;
       }
-      r++;
     }
     // Mark rows as needing to be cleared
     for (int r = lowestHoleInCol - 1; r >= 20 - surfaceArray[c]; r--) {
@@ -351,3 +451,247 @@ GameState advanceGameState(GameState gameState, LockPlacement lockPlacement, con
 
   return newState;
 }
+
+
+/* ----------- TESTS ----------- */
+
+/**
+ * The original version of updateSurfaceAndHoles(), kept unchanged as the reference for testUpdateSurfaceAndHoles(): each
+ * column searches down from its previous surface, then every empty cell under the surface is rated on its own.
+ */
+std::pair<int, float> updateSurfaceAndHolesByCell(int surfaceArray[10], unsigned int board[20], int excludeHolesColumn, bool isDigMode) {
+  // Reset hole and tuck setup bits
+  for (int i = 0; i < 20; i++) {
+    board[i] &= ~ALL_AUXILIARY_BITS;
+  }
+  int numTrueHoles = 0;
+  float numPartialHoles = 0;
+  
+  // Calculate the new surface array first, since its value is used in subsequent calculations
+  for (int c = 0; c < 10; c++) {
+    int mask = 1 << (9 - c);
+    int r = 20 - surfaceArray[c];
+    while (r >= 0 && r < 20 && !(board[r] & mask)) {
+      r++;
+    }
+    // Update the new surface array
+    surfaceArray[c] = 20 - r;
+  }
+  
+  // Update hole and tuck setup info
+  for (int c = 0; c < 10; c++) {
+    int mask = 1 << (9 - c);
+    int r = 20 - surfaceArray[c];
+    // VARIABLE_RANGE_CHECKS
+    r = max(0, r);
+    r = min(20, r);
+    int lowestHoleInCol = -1;
+    while (r < 20) {
+      // Add new holes to the overall count, unless they're in the well
+      if (!(board[r] & mask)) {
+        float rating = analyzeHole(board, r, c, excludeHolesColumn, surfaceArray, isDigMode);
+        // Check that it's a hole (1.0) and not a tuck setup (eg. 0.9)
+        if (rating == 1){
+          lowestHoleInCol = r;
+          numTrueHoles += 1;
+        } else {
+          numPartialHoles += rating;
+        }
+      }
+      r++;
+    }
+    // Mark rows as needing to be cleared
+    for (int r = lowestHoleInCol - 1; r >= 20 - surfaceArray[c]; r--) {
+      if (VARIABLE_RANGE_CHECKS_ENABLED && (r < 0 || r >= 20)){
+        printf("R value out of range %d\n", r);
+        break;
+        // throw std::invalid_argument( "r value out of range" );
+      }
+      board[r] |= HOLE_WEIGHT_BIT;
+    }
+  }
+  return pair<int, float>(numTrueHoles, numPartialHoles);
+}
+
+/**
+ * Checks that updateSurfaceAndHoles() matches the cell-by-cell version exactly (hole counts, surface and auxiliary bits)
+ * on random boards, including previous surfaces that are off (as they are after line clears, where they're too high).
+ * @returns the number of mismatches
+ */
+int testUpdateSurfaceAndHoles(int numBoards) {
+  std::vector<GameState> gameStates;
+  makeRandomGameStates(numBoards, /* seed= */ 12345, /* minFillPercent= */ 40, gameStates);
+  // For the previous surfaces, well column and mode of each board
+  std::mt19937 generator(12345);
+  int numMismatched = 0;
+  for (GameState &gameState : gameStates) {
+    unsigned int *board = gameState.board;
+    int *surfaceArray = gameState.surfaceArray;
+    for (int c = 0; c < 10; c++) {
+      if (generator() % 4 == 0) {
+        surfaceArray[c] = std::max(0, std::min(20, surfaceArray[c] + (int) (generator() % 7) - 3));
+      }
+    }
+    int excludeHolesColumn = (int) (generator() % 11) - 1;
+    bool isDigMode = generator() % 2;
+
+    unsigned int expectedBoard[20];
+    unsigned int actualBoard[20];
+    int expectedSurface[10];
+    int actualSurface[10];
+    copyBoard(board, expectedBoard);
+    copyBoard(board, actualBoard);
+    memcpy(expectedSurface, surfaceArray, sizeof(expectedSurface));
+    memcpy(actualSurface, surfaceArray, sizeof(actualSurface));
+    std::pair<int, float> expected = updateSurfaceAndHolesByCell(expectedSurface, expectedBoard, excludeHolesColumn, isDigMode);
+    std::pair<int, float> actual = updateSurfaceAndHoles(actualSurface, actualBoard, excludeHolesColumn, isDigMode);
+    if (expected != actual
+        || memcmp(expectedBoard, actualBoard, sizeof(expectedBoard)) != 0
+        || memcmp(expectedSurface, actualSurface, sizeof(expectedSurface)) != 0) {
+      printf("Mismatch: holes %d %f vs %d %f\n", expected.first, expected.second, actual.first, actual.second);
+      printBoard(board);
+      numMismatched++;
+    }
+  }
+  return numMismatched;
+}
+
+/**
+ * The original version of analyzeHole(), with every tuck setup checked in turn, kept unchanged as the reference for
+ * testAnalyzeHole().
+ */
+float analyzeHoleByLadder(unsigned int board[20], int r, int c, int excludeHolesColumn, int surfaceArray[10], bool isDigMode){
+  // VARIABLE_RANGE_CHECKS_ENABLED
+  if (true && (r < 0 || r >= 20)){
+    printf("PANIK B, r=%d\n", r);
+  }
+  if (CAN_TUCK){
+    if (c >= 4 
+        && ((board[r] >> (9-c)) & 0b11111) == 0
+        && (20 - surfaceArray[c-1] == r+1)
+        && (surfaceArray[c-2] == surfaceArray[c-1])
+        && (surfaceArray[c-3] == surfaceArray[c-2])
+        && (surfaceArray[c-4] == surfaceArray[c-3])){
+      board[r] |= TUCK_SETUP_BIT(c); // Mark this cell as an overhang cell
+      return 0.2f; // Left side 1-high tuck, with ample space = 4+ pieces solve.
+    }
+    if (c >= 3 
+        && ((board[r] >> (9-c)) & 0b1111) == 0
+        && (20 - surfaceArray[c-1] == r+1)
+        && (surfaceArray[c-2] == surfaceArray[c-1])
+        && (surfaceArray[c-3] == surfaceArray[c-2])){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.35f; // Left side 1-high tuck, with some space = generally 3+ pieces solve.
+    }
+    if (!isDigMode && c >= 3 
+        && ((board[r] >> (9-c)) & 0b1111) == 0
+        && (20 - surfaceArray[c-1] > r+1)
+        && (surfaceArray[c-2] == surfaceArray[c-1])
+        && (surfaceArray[c-3] == surfaceArray[c-2])){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.5f; // Left side tuck raised off the ground, with some space = generally 2 pieces solve.
+    }
+    if (!isDigMode && c >= 2
+        && ((board[r] >> (9-c)) & 0b111) == 0
+        && (20 - surfaceArray[c-1] >= r+1)
+        && (20 - surfaceArray[c-2] >= r+1)){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.75f; // Left side tuck, with minimal space = generally 1-piece solve.
+    }
+    if (c <= 5 
+        && ((board[r] >> (5-c)) & 0b11111) == 0
+        && (20 - surfaceArray[c+1] == r+1)
+        && (surfaceArray[c+2] == surfaceArray[c+1])
+        && (surfaceArray[c+3] == surfaceArray[c+2])
+        && (surfaceArray[c+4] == surfaceArray[c+3])){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.1875; // Right side 1-high tuck, with ample space = 4+ piece solve
+    }
+    if (c <= 6 
+        && ((board[r] >> (6-c)) & 0b1111) == 0
+        && (20 - surfaceArray[c+1] == r+1)
+        && (surfaceArray[c+2] == surfaceArray[c+1])
+        && (surfaceArray[c+3] == surfaceArray[c+2])){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.325f; // Right side 1-high tuck, with some space = generally 3+ pieces solve.
+    }
+    if (!isDigMode && c <= 6 
+        && ((board[r] >> (6-c)) & 0b1111) == 0
+        && (20 - surfaceArray[c+1] > r+1)
+        && (surfaceArray[c+2] == surfaceArray[c+1])
+        && (surfaceArray[c+3] == surfaceArray[c+2])){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.45f; // Right side tuck raised off the ground, with some space = generally 2 pieces solve.
+    }
+    if (!isDigMode && c <= 7
+        && ((board[r] >> (7-c)) & 0b111) == 0
+        && (20 - surfaceArray[c+1] >= r+1)
+        && (20 - surfaceArray[c+2] >= r+1)){
+      board[r] |= TUCK_SETUP_BIT(c);
+      return 0.65f; // Right side tuck, with minimal space = 1-piece solve + spin option.
+    }
+    if (!isDigMode && c == 8
+        && r <= 16
+        && (board[r] & 0b11) == 0
+        && (board[r+1] & 0b11) == 0
+        && (board[r+2] & 0b11) == 0
+        && (board[r+3] & 0b11) == 0){
+      board[r] |= TUCK_SETUP_BIT(c);
+      board[r+1] |= TUCK_SETUP_BIT(c);
+      board[r+2] |= TUCK_SETUP_BIT(c);
+      board[r+3] |= TUCK_SETUP_BIT(c);
+      return 0.8f; // column 9 vits = 1-piece solve
+    }
+  }
+  if (c == excludeHolesColumn) {
+    if ((board[r] & ALL_HOLE_BITS) == 0){
+      // Not strictly a problem, if the holes are cleared this is just a regular well
+      return 0;
+    } else {
+      // The well needs to be filled to clear some hole. Treat it almost like a hole itself
+      return SEMI_HOLE_PROPORTION;
+    }
+  }
+  // Otherwise it's a hole
+  // printf("MARKING HOLE %d %d\n", c, r);
+  board[r] |= HOLE_BIT(c);
+  return 1;
+}
+
+/**
+ * Checks that analyzeHole() matches the original version exactly (ratings and the hole and tuck setup bits it marks), on
+ * every empty cell of random boards, in and out of dig mode and with every well column.
+ * @returns the number of boards with a mismatch
+ */
+int testAnalyzeHole(int numBoards) {
+  std::vector<GameState> gameStates;
+  makeRandomGameStates(numBoards, /* seed= */ 54321, /* minFillPercent= */ 30, gameStates);
+  int numMismatched = 0;
+  for (int i = 0; i < numBoards; i++) {
+    GameState &gameState = gameStates[i];
+    int excludeHolesColumn = i % 11 - 1;
+    bool isDigMode = (i / 11) % 2;
+    // Rate the cells in order on the same board, as updateSurfaceAndHoles does, so that the well sees the marked holes
+    unsigned int expectedBoard[20];
+    unsigned int actualBoard[20];
+    copyBoard(gameState.board, expectedBoard);
+    copyBoard(gameState.board, actualBoard);
+    bool isMismatched = false;
+    for (int c = 0; c < 10 && !isMismatched; c++) {
+      for (int r = 0; r < 20 && !isMismatched; r++) {
+        if (gameState.board[r] & CELL_BIT(c)) {
+          continue;
+        }
+        float expected = analyzeHoleByLadder(expectedBoard, r, c, excludeHolesColumn, gameState.surfaceArray, isDigMode);
+        float actual = analyzeHole(actualBoard, r, c, excludeHolesColumn, gameState.surfaceArray, isDigMode);
+        if (expected != actual || memcmp(expectedBoard, actualBoard, sizeof(expectedBoard)) != 0) {
+          printf("Mismatch at r=%d c=%d well=%d dig=%d: %f vs %f\n", r, c, excludeHolesColumn, isDigMode, expected, actual);
+          printBoard(gameState.board);
+          isMismatched = true;
+        }
+      }
+    }
+    numMismatched += isMismatched;
+  }
+  return numMismatched;
+}
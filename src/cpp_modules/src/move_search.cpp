@@ -1,11 +1,15 @@
 #include "move_search.hpp"
+#include "flood_fill_search.hpp"
 #include "piece_ranges.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
 #include <cmath>
+#include <mutex>
 #include <stdio.h>
 #include <string.h>
-#include <unordered_set>
 #include <vector>
 #include "utils.hpp"
 #include "types.hpp"
@@ -15,23 +19,16 @@ using namespace std;
  * Checks for collisions with the board and the edges of the screen
  */
 int collision(unsigned int board[20], const Piece *piece, int x, int y, int rotIndex) {
-  if (y > piece->maxYByRotation[rotIndex]) {
+  const PieceMask &mask = PIECE_MASK_TABLE[piece->index][rotIndex][x + PIECE_MASK_TABLE_OFFSET];
+  // Out-of-bounds X values are folded into the max Y, so this covers the walls and the floor
+  if (y > mask.maxY) {
     return 1;
   }
-  if (X_BOUNDS_COLLISION_TABLE[piece->index][rotIndex][x + X_BOUNDS_COLLISION_TABLE_OFFSET]) {
-    return 1;
-  }
-  for (int r = 0; r < 4; r++) {
-    // Don't collide above ceiling
-    if (y + r < 0) {
-      continue;
-    }
-    int pieceRow = piece->rowsByRotation[rotIndex][r];
-    if (pieceRow == 0) {
-      continue;
-    }
-    // Board collisions
-    if (SHIFTBY(pieceRow, x) & board[y + r]) {
+  // Don't collide above the ceiling, or read past the bottom of the board for the piece's empty rows
+  int rStart = y < 0 ? -y : 0;
+  int rEnd = y > 16 ? 20 - y : 4;
+  for (int r = rStart; r < rEnd; r++) {
+    if (mask.rows[r] & board[y + r]) {
       return 1;
     }
   }
@@ -56,24 +53,26 @@ int rotateTowardsGoal(int curRotation, int goalRotation) {
 
 /**
  * Explores how far in a given direction a piece can be shifted, and registers all the legal placements along
- * the way
+ * the way.
+ * @param trajectory - if non-null, every collision check and registered placement is recorded here, in order
  */
 int exploreHorizontally(unsigned int board[20],
                         SimState simState,
                         int shiftIncrement,
                         int maxOrMinX,
                         int goalRotationIndex,
-                        char const *inputFrameTimeline,
+                        InputTimeline const &inputTimeline,
                         int gravity,
                         bool gravityDoubled,
-                        vector<SimState> &legalPlacements,
-                        int availableTuckCols[40]) {
+                        SimStateList &legalPlacements,
+                        int availableTuckCols[40],
+                        OUT vector<TrajectoryCell> *trajectory) {
   int rangeCurrent = 0;
   debugPrint("Exploring horizontally, inc=%d maxmin=%d goalRot=%d\n", shiftIncrement, maxOrMinX, goalRotationIndex);
 
   // Loop through hypothetical frames
   while (simState.x != maxOrMinX || simState.rotationIndex != goalRotationIndex) {
-    int isInputFrame = shouldPerformInputsThisFrame(simState.arrIndex, inputFrameTimeline);
+    int isInputFrame = shouldPerformInputsThisFrame(simState.arrIndex, inputTimeline);
     int isGravityFrame =
       simState.frameIndex % gravity == gravity - 1;   // Returns true every Nth frame, where N = gravity
     // Event trackers to handle the ordering of a few edge cases (explained more below)
@@ -83,6 +82,9 @@ int exploreHorizontally(unsigned int board[20],
     if (isInputFrame) {
       // Try shifting
       if (simState.x != maxOrMinX) {
+        if (trajectory != NULL) {
+          trajectory->push_back({simState.x + shiftIncrement, simState.y, simState.rotationIndex, simState.frameIndex, INPUT_CHECK, false});
+        }
         if (collision(
               board, simState.piece, simState.x + shiftIncrement, simState.y, simState.rotationIndex)) {
           debugPrint("Shift collision at xOff=%d\n", simState.x - INITIAL_X);
@@ -94,6 +96,9 @@ int exploreHorizontally(unsigned int board[20],
       // Try rotating
       if (simState.rotationIndex != goalRotationIndex) {
         int rotationAfter = rotateTowardsGoal(simState.rotationIndex, goalRotationIndex);
+        if (trajectory != NULL) {
+          trajectory->push_back({simState.x, simState.y, rotationAfter, simState.frameIndex, INPUT_CHECK, false});
+        }
         if (collision(board, simState.piece, simState.x, simState.y, rotationAfter)) {
           if (MOVE_SEARCH_DEBUG_LOGGING){
             printf("Rotation collision at x=%d, rot=%d\n", simState.x - INITIAL_X, rotationAfter);
@@ -115,6 +120,9 @@ int exploreHorizontally(unsigned int board[20],
 
     if (isGravityFrame) {
       for (int i = 0; i < (gravityDoubled ? 2 : 1); i++){
+        if (trajectory != NULL) {
+          trajectory->push_back({simState.x, simState.y + 1, simState.rotationIndex, simState.frameIndex, GRAVITY_CHECK, (bool) foundNewPlacementThisFrame});
+        }
         if (collision(board, simState.piece, simState.x, simState.y + 1, simState.rotationIndex)) {
           didLockThisFrame = true;
           break;
@@ -145,6 +153,9 @@ int exploreHorizontally(unsigned int board[20],
                simState.frameIndex);
       }
       legalPlacements.push_back(simState);
+      if (trajectory != NULL) {
+        trajectory->push_back({simState.x, simState.y, simState.rotationIndex, simState.frameIndex, REGISTER_PLACEMENT, false});
+      }
     }
     if (didLockThisFrame) {
       // printf("LOCKED due to gravity: %d %d %d, frame=%d", simState.rotationIndex, simState.x - INITIAL_X,
@@ -158,15 +169,17 @@ int exploreHorizontally(unsigned int board[20],
 /**
  * Explores for moves with more rotations than shifts (the only blind spot of the default exploration
  * behavior).
+ * @param trajectories - if non-null, one recorded trajectory is appended per exploration
  */
 void explorePlacementsNearSpawn(unsigned int board[20],
                                 SimState simState,
                                 int goalRotationIndex,
-                                char const *inputFrameTimeline,
+                                InputTimeline const &inputTimeline,
                                 int gravity,
                                 bool gravityDoubled,
-                                vector<SimState> &legalPlacements,
-                                int availableTuckCols[40]) {
+                                SimStateList &legalPlacements,
+                                int availableTuckCols[40],
+                                OUT vector<vector<TrajectoryCell>> *trajectories) {
   int rotationDifference = abs(goalRotationIndex - simState.rotationIndex);
   /* The goal placement is in the blind spot of the main algorithm if there are more rotations than shifts.
    Therefore, for double rotations, the X could be anywhere from -1 to 1. For single rotations, they would always be in place. */
@@ -174,29 +187,262 @@ void explorePlacementsNearSpawn(unsigned int board[20],
   int rangeEnd = rotationDifference == 2 ? 1 : 0;
 
   for (int xOffset = rangeStart; xOffset <= rangeEnd; xOffset++) {
+    vector<TrajectoryCell> *trajectory = NULL;
+    if (trajectories != NULL) {
+      trajectories->emplace_back();
+      trajectory = &trajectories->back();
+    }
     // Check if the placement is legal.
     exploreHorizontally(board,
                         simState,
                         xOffset,
                         simState.x + xOffset,
                         goalRotationIndex,
-                        inputFrameTimeline,
+                        inputTimeline,
                         gravity,
                         gravityDoubled,
                         legalPlacements,
-                        availableTuckCols);
+                        availableTuckCols,
+                        trajectory);
+  }
+}
+
+/**
+ * Replays a precomputed trajectory against a board, registering placements until the first collision.
+ * Equivalent to calling exploreHorizontally() with the same parameters that the trajectory was recorded with.
+ */
+void replayTrajectory(unsigned int board[20],
+                      const Piece *piece,
+                      const vector<TrajectoryCell> &trajectory,
+                      SimStateList &legalPlacements) {
+  for (TrajectoryCell const &cell : trajectory) {
+    if (cell.type == REGISTER_PLACEMENT) {
+      legalPlacements.push_back({cell.x, cell.y, cell.rotationIndex, cell.frameIndex, cell.frameIndex, piece});
+      continue;
+    }
+    if (collision(board, piece, cell.x, cell.y, cell.rotationIndex)) {
+      // If the piece locked on a frame where it reached the goal rotation, that's still a legal placement (see exploreHorizontally)
+      if (cell.type == GRAVITY_CHECK && cell.foundPlacementThisFrame) {
+        legalPlacements.push_back({cell.x, cell.y - 1, cell.rotationIndex, cell.frameIndex + 1, cell.frameIndex + 1, piece});
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * A batch of boards, stored such that the same row of every board is contiguous.
+ * That way, checking one piece position against every board in the batch is a loop that the compiler can vectorize.
+ */
+struct BoardBatch {
+  unsigned int rows[20][MOVE_SEARCH_BATCH_SIZE];
+};
+
+/**
+ * Checks one piece position against every board in a batch, loading the piece mask once.
+ * @returns a bitmask with bit N set if the piece collides on board N
+ */
+unsigned int collisionBatch(BoardBatch const &batch, const Piece *piece, int x, int y, int rotIndex) {
+  const PieceMask &mask = PIECE_MASK_TABLE[piece->index][rotIndex][x + PIECE_MASK_TABLE_OFFSET];
+  // The walls and the floor are the same on every board
+  if (y > mask.maxY) {
+    return (1U << MOVE_SEARCH_BATCH_SIZE) - 1;
+  }
+  int rStart = y < 0 ? -y : 0;
+  int rEnd = y > 16 ? 20 - y : 4;
+  unsigned int overlap[MOVE_SEARCH_BATCH_SIZE] = {};
+  for (int r = rStart; r < rEnd; r++) {
+    unsigned int pieceRow = mask.rows[r];
+    unsigned int const *boardRows = batch.rows[y + r];
+    for (int lane = 0; lane < MOVE_SEARCH_BATCH_SIZE; lane++) {
+      overlap[lane] |= pieceRow & boardRows[lane];
+    }
+  }
+  unsigned int collided = 0;
+  for (int lane = 0; lane < MOVE_SEARCH_BATCH_SIZE; lane++) {
+    collided |= (overlap[lane] != 0) << lane;
+  }
+  return collided;
+}
+
+/**
+ * Replays a precomputed trajectory against every board in a batch at once.
+ * Equivalent to calling replayTrajectory() on each board whose bit is set in activeLanes.
+ */
+void replayTrajectoryBatch(BoardBatch const &batch,
+                           unsigned int activeLanes,
+                           const Piece *piece,
+                           const vector<TrajectoryCell> &trajectory,
+                           SimStateList legalPlacementsByLane[MOVE_SEARCH_BATCH_SIZE]) {
+  for (TrajectoryCell const &cell : trajectory) {
+    if (cell.type == REGISTER_PLACEMENT) {
+      for (int lane = 0; lane < MOVE_SEARCH_BATCH_SIZE; lane++) {
+        if (activeLanes & (1U << lane)) {
+          legalPlacementsByLane[lane].push_back({cell.x, cell.y, cell.rotationIndex, cell.frameIndex, cell.frameIndex, piece});
+        }
+      }
+      continue;
+    }
+    unsigned int collided = collisionBatch(batch, piece, cell.x, cell.y, cell.rotationIndex) & activeLanes;
+    if (collided == 0) {
+      continue;
+    }
+    // If the piece locked on a frame where it reached the goal rotation, that's still a legal placement (see exploreHorizontally)
+    if (cell.type == GRAVITY_CHECK && cell.foundPlacementThisFrame) {
+      for (int lane = 0; lane < MOVE_SEARCH_BATCH_SIZE; lane++) {
+        if (collided & (1U << lane)) {
+          legalPlacementsByLane[lane].push_back({cell.x, cell.y - 1, cell.rotationIndex, cell.frameIndex + 1, cell.frameIndex + 1, piece});
+        }
+      }
+    }
+    activeLanes &= ~collided;
+    if (activeLanes == 0) {
+      return;
+    }
+  }
+}
+
+/**
+ * Precomputed move search trajectories from spawn, for every piece and goal rotation.
+ * The frames simulated from spawn only depend on the input timeline and gravity, so these are recorded once on an empty board.
+ */
+struct MoveSearchTemplate {
+  InputTimeline inputTimeline;
+  int gravity;
+  bool gravityDoubled;
+  // In the same order as the exploration passes in moveSearchInternal
+  vector<vector<TrajectoryCell>> trajectories[7][4];
+  // The Y value at each shift from spawn, by piece (see computeYValueOfEachShift)
+  int minTuckYValsByNumPrevInputs[7][7];
+  // The legal midair placements that replaying every trajectory finds on an empty board, by piece
+  SimStateList emptyBoardPlacements[7];
+  // The tallest stack that none of a piece's trajectories can reach. Any board whose surface is at or below this finds
+  // exactly the empty board placements, since every collision check comes out the same as on an empty board.
+  int maxUnreachableStackHeight[7];
+};
+
+#define MAX_MOVE_SEARCH_TEMPLATES 32
+
+MoveSearchTemplate moveSearchTemplates[MAX_MOVE_SEARCH_TEMPLATES];
+std::atomic<int> numMoveSearchTemplates(0);
+std::mutex moveSearchTemplateMutex;
+
+/**
+ * Finds the lowest board row that a trajectory checks for collisions.
+ * Checks that are out of bounds (past the walls or floor) are skipped, since they collide regardless of the board.
+ */
+int getDeepestRowChecked(const Piece *piece, const vector<TrajectoryCell> &trajectory) {
+  int deepestRow = -1;
+  for (TrajectoryCell const &cell : trajectory) {
+    const PieceMask &mask = PIECE_MASK_TABLE[piece->index][cell.rotationIndex][cell.x + PIECE_MASK_TABLE_OFFSET];
+    if (cell.type == REGISTER_PLACEMENT || cell.y > mask.maxY) {
+      continue;
+    }
+    for (int r = 3; r >= 0; r--) {
+      if (mask.rows[r] != 0) {
+        deepestRow = max(deepestRow, min(cell.y + r, 19));
+        break;
+      }
+    }
   }
+  return deepestRow;
 }
 
+void recordMoveSearchTemplate(InputTimeline const &inputTimeline, int gravity, bool gravityDoubled, OUT MoveSearchTemplate &moveTemplate) {
+  unsigned int emptyBoard[20] = {};
+  SimStateList unusedPlacements;
+  int unusedTuckCols[40] = {};
+  moveTemplate.inputTimeline = inputTimeline;
+  moveTemplate.gravity = gravity;
+  moveTemplate.gravityDoubled = gravityDoubled;
+  for (int p = 0; p < 7; p++) {
+    const Piece *piece = &PIECE_LIST[p];
+    computeYValueOfEachShift(inputTimeline, gravity, gravityDoubled, piece->initialY, moveTemplate.minTuckYValsByNumPrevInputs[p]);
+    SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+    for (int goalRotIndex = 0; goalRotIndex < 4; goalRotIndex++) {
+      vector<vector<TrajectoryCell>> &trajectories = moveTemplate.trajectories[p][goalRotIndex];
+      trajectories.clear();
+      if (piece->rowsByRotation[goalRotIndex][0] == NONE) {
+        continue;
+      }
+      unusedPlacements.clear();
+      trajectories.emplace_back();
+      exploreHorizontally(emptyBoard, spawnState, -1, -99, goalRotIndex, inputTimeline, gravity, gravityDoubled, unusedPlacements, unusedTuckCols, &trajectories.back());
+      trajectories.emplace_back();
+      exploreHorizontally(emptyBoard, spawnState, 1, 99, goalRotIndex, inputTimeline, gravity, gravityDoubled, unusedPlacements, unusedTuckCols, &trajectories.back());
+      explorePlacementsNearSpawn(emptyBoard, spawnState, goalRotIndex, inputTimeline, gravity, gravityDoubled, unusedPlacements, unusedTuckCols, &trajectories);
+    }
+
+    // Replay the trajectories on the empty board, in the same order as moveSearchInternal, for the low stack fast path
+    SimStateList &emptyBoardPlacements = moveTemplate.emptyBoardPlacements[p];
+    emptyBoardPlacements.clear();
+    emptyBoardPlacements.push_back(spawnState);
+    int deepestRow = getDeepestRowChecked(piece, {{spawnState.x, spawnState.y, spawnState.rotationIndex, 0, INPUT_CHECK, false}});
+    for (int goalRotIndex = 0; goalRotIndex < 4; goalRotIndex++) {
+      for (auto const &trajectory : moveTemplate.trajectories[p][goalRotIndex]) {
+        replayTrajectory(emptyBoard, piece, trajectory, emptyBoardPlacements);
+        deepestRow = max(deepestRow, getDeepestRowChecked(piece, trajectory));
+      }
+    }
+    moveTemplate.maxUnreachableStackHeight[p] = 19 - deepestRow;
+  }
+}
+
+const MoveSearchTemplate *findMoveSearchTemplate(InputTimeline const &inputTimeline, int gravity, bool gravityDoubled, int numPublished) {
+  for (int i = 0; i < numPublished; i++) {
+    MoveSearchTemplate const &moveTemplate = moveSearchTemplates[i];
+    // Timelines are equivalent if they have the same repeating pattern
+    if (moveTemplate.gravity == gravity && moveTemplate.gravityDoubled == gravityDoubled
+        && moveTemplate.inputTimeline.period == inputTimeline.period
+        && moveTemplate.inputTimeline.inputFrameMask == inputTimeline.inputFrameMask) {
+      return &moveTemplate;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Gets the precomputed trajectories for a given timeline and gravity, recording them on first use.
+ * Templates are never evicted, so lookups of already-published templates don't need the lock.
+ * @returns NULL if the cache is full, in which case the caller should simulate the frames directly
+ */
+const MoveSearchTemplate *getMoveSearchTemplate(InputTimeline const &inputTimeline, int gravity, bool gravityDoubled) {
+  const MoveSearchTemplate *existing = findMoveSearchTemplate(inputTimeline, gravity, gravityDoubled, numMoveSearchTemplates.load(std::memory_order_acquire));
+  if (existing != NULL) {
+    return existing;
+  }
+
+  std::lock_guard<std::mutex> lock(moveSearchTemplateMutex);
+  // Another thread may have recorded it while we were waiting
+  int numPublished = numMoveSearchTemplates.load(std::memory_order_relaxed);
+  existing = findMoveSearchTemplate(inputTimeline, gravity, gravityDoubled, numPublished);
+  if (existing != NULL) {
+    return existing;
+  }
+  if (numPublished >= MAX_MOVE_SEARCH_TEMPLATES) {
+    return NULL;
+  }
+  recordMoveSearchTemplate(inputTimeline, gravity, gravityDoubled, moveSearchTemplates[numPublished]);
+  numMoveSearchTemplates.store(numPublished + 1, std::memory_order_release);
+  return &moveSearchTemplates[numPublished];
+}
+
+// Lock placements are deduplicated by lock position, since each position leaves a different resulting board.
+// Legal lock positions have x in [-2, 7] and y in [-2, 19].
+#define LOCK_SPOT_RANGE (4 * 32 * 16)
+#define LOCK_SPOT_INDEX(x, y, rot) ((rot) * 512 + ((y) + 4) * 16 + (x) + 4)
+
 /**
  * Optimized method to convert legal placements to lock placements.
+ * Placements that lock in a spot that's already in lockSpots are skipped, since they'd leave the same board.
  * (!!) Doesn't allow for tucks.
  */
-void getLockPlacementsFast(vector<SimState> &legalPlacements,
+void getLockPlacementsFast(SimStateList &legalPlacements,
                            unsigned int board[20],
                            int surfaceArray[10],
                            OUT int availableTuckCols[40],
-                           OUT vector<LockPlacement> &lockPlacements) {
+                           OUT std::bitset<LOCK_SPOT_RANGE> &lockSpots,
+                           OUT LockPlacementList &lockPlacements) {
   for (auto simState : legalPlacements) {
     unsigned int const *bottomSurface = simState.piece->bottomSurfaceByRotation[simState.rotationIndex];
     int rowsToShift = 99999;
@@ -229,28 +475,57 @@ void getLockPlacementsFast(vector<SimState> &legalPlacements,
     availableTuckCols[TUCK_COL_ENCODED(simState.rotationIndex, simState.x)] = simState.y;
     // printf("AvalTuckCols[%d] = %d\n", TUCK_COL_ENCODED(simState.rotationIndex, simState.x) + 40,
     // simState.y);
+    int lockSpotIndex = LOCK_SPOT_INDEX(simState.x, simState.y, simState.rotationIndex);
+    if (lockSpots[lockSpotIndex]) {
+      continue; // Several exploration passes can reach the same spot
+    }
+    lockSpots[lockSpotIndex] = true;
     lockPlacements.push_back({simState.x, simState.y, simState.rotationIndex, -1, NO_TUCK_NOTATION, simState.piece});
   }
 }
 
-char findTuckInput(unsigned int board[20],
-                   SimState afterTuckState,
-                   int availableTuckCols[40],
-                   int minTuckYValsByNumPrevInputs[7]) {
+/** Undoes a tuck input, giving the x value and rotation the piece had before it. */
+void getPreTuckState(SimState const &afterTuckState, TuckInput const &tuckInput, OUT int &preTuckX, OUT int &preTuckRotIndex) {
   // Do rotations mod 4 or mod 2, depending on the piece (rotation logic skipped for O)
   int numOrientations = afterTuckState.piece->id == 'O'                    ? 1
                         : afterTuckState.piece->rowsByRotation[3][0] == NONE ? 2
                                                                           : 4;
   int rotationModulusMask = numOrientations == 4 ? 3 : 1;
+  preTuckRotIndex = afterTuckState.rotationIndex;
+  preTuckX = afterTuckState.x - tuckInput.xChange; // Do the input in reverse
+  if (afterTuckState.piece->id != 'O') {
+    preTuckRotIndex = (preTuckRotIndex - tuckInput.rotationChange + 4) & rotationModulusMask;
+  }
+}
+
+/** Checks that the piece isn't blocked partway through a tuck input, since the order goes Shift -> Rotate -> Drop. */
+bool fitsThroughTuck(unsigned int board[20], SimState const &afterTuckState, int preTuckX, int preTuckRotIndex) {
+  // Check that it doesn't collide with the board after just the shift
+  if (collision(board, afterTuckState.piece, afterTuckState.x, afterTuckState.y, preTuckRotIndex)) {
+    maybePrint("Tuck collided with board after shift\n");
+    return false;
+  }
+  // Check that it doesn't collide with the board before both the shift and the rotation
+  if (collision(board, afterTuckState.piece, preTuckX, afterTuckState.y, preTuckRotIndex)) {
+    maybePrint("Tuck collided with board before tuck. x=%d, y=%d, rot=%d\n",
+               preTuckX,
+               afterTuckState.y,
+               preTuckRotIndex);
+    return false;
+  }
+  return true;
+}
+
+char findTuckInput(unsigned int board[20],
+                   SimState afterTuckState,
+                   int availableTuckCols[40],
+                   int minTuckYValsByNumPrevInputs[7]) {
   for (TuckInput tuckInput : TUCK_INPUTS) {
     maybePrint("Trying %c:\n", tuckInput.notation);
     // Apply the tuck in reverse to get the pre-tuck state
-    int preTuckRotIndex = afterTuckState.rotationIndex;
-    int preTuckX = afterTuckState.x;
-    preTuckX -= tuckInput.xChange; // Do the input in reverse
-    if (afterTuckState.piece->id != 'O') {
-      preTuckRotIndex = (preTuckRotIndex - tuckInput.rotationChange + 4) & rotationModulusMask;
-    }
+    int preTuckX;
+    int preTuckRotIndex;
+    getPreTuckState(afterTuckState, tuckInput, preTuckX, preTuckRotIndex);
 
     // Validate the pre-tuck state
     int index = TUCK_COL_ENCODED(preTuckRotIndex, preTuckX);
@@ -259,28 +534,16 @@ char findTuckInput(unsigned int board[20],
     int minY = minTuckYValsByNumPrevInputs[numInputs + 1];
     int maxY = availableTuckCols[index];
     if (afterTuckState.y < minY || afterTuckState.y > maxY) {
-      maybePrint("Tuck not in y range. Actual=%d, Range= %d to %d (orients=%d, rot=%d, x=%d, index=%d)\n",
+      maybePrint("Tuck not in y range. Actual=%d, Range= %d to %d (rot=%d, x=%d, index=%d)\n",
                  afterTuckState.y,
                  minY,
                  maxY,
-                 numOrientations,
                  preTuckRotIndex,
                  preTuckX,
                  index);
       continue;
     }
-    // Check that it doesn't collide with the board after just the shift (the order goes Shift -> Rotate ->
-    // Drop)
-    if (collision(board, afterTuckState.piece, afterTuckState.x, afterTuckState.y, preTuckRotIndex)) {
-      maybePrint("Tuck collided with board after shift\n");
-      continue;
-    }
-    // Check that it doesn't collide with the board before both the shift and the rotation
-    if (collision(board, afterTuckState.piece, preTuckX, afterTuckState.y, preTuckRotIndex)) {
-      maybePrint("Tuck collided with board before tuck. x=%d, y=%d, rot=%d\n",
-                 preTuckX,
-                 afterTuckState.y,
-                 preTuckRotIndex);
+    if (!fitsThroughTuck(board, afterTuckState, preTuckX, preTuckRotIndex)) {
       continue;
     }
     return tuckInput.notation;
@@ -289,19 +552,75 @@ char findTuckInput(unsigned int board[20],
   return NO_TUCK_NOTATION;
 }
 
+/*
+   The tuck spots that fit around an overhang cell only depend on the 7x7 window of cells centered on it, since every
+   spot puts the piece's 4x4 box within 3 cells of the overhang. The window is looked up one row at a time: each entry
+   is the set of spots (as bits, in the piece's TUCK_SPOTS order) that don't collide with that row of the window.
+   ANDing the 7 rows together gives exactly the spots where collision() would return false.
+*/
+#define TUCK_WINDOW_RADIUS 3
+#define TUCK_WINDOW_SIZE (2 * TUCK_WINDOW_RADIUS + 1)
+
+typedef array<array<array<unsigned char, 1 << TUCK_WINDOW_SIZE>, TUCK_WINDOW_SIZE>, 7> tuckfittable;
+
+tuckfittable getTuckFitTable() {
+  tuckfittable table = {};
+  for (int p = 0; p < 7; p++) {
+    for (int windowRow = 0; windowRow < TUCK_WINDOW_SIZE; windowRow++) {
+      for (int windowBits = 0; windowBits < (1 << TUCK_WINDOW_SIZE); windowBits++) {
+        unsigned char fits = 0;
+        int spotIndex = 0;
+        for (TuckOriginSpot spot : TUCK_SPOTS_LIST[p]) {
+          // The row of the piece's 4x4 box that lands on this row of the window, if any
+          int pieceRowIndex = windowRow - TUCK_WINDOW_RADIUS + spot.y;
+          unsigned int pieceRow = pieceRowIndex >= 0 && pieceRowIndex < 4 ? PIECE_LIST[p].rowsByRotation[spot.orientation][pieceRowIndex] : 0;
+          // The box's leftmost column (bit 9 of the piece row) lines up with window bit (TUCK_WINDOW_RADIUS + spot.x)
+          unsigned int shiftedPieceRow = SHIFTBY(pieceRow, 9 - (TUCK_WINDOW_SIZE - 1) + TUCK_WINDOW_RADIUS - spot.x);
+          if ((shiftedPieceRow & windowBits) == 0) {
+            fits |= 1 << spotIndex;
+          }
+          spotIndex++;
+        }
+        table[p][windowRow][windowBits] = fits;
+      }
+    }
+  }
+  return table;
+}
+
+const tuckfittable TUCK_FIT_TABLE = getTuckFitTable();
+
 /**
-   Searches for tucks by 1) Finding all of the overhang cells from the board array, then 2) looping over the
-   overhang cells and trying all the ways that the piece could possibly fill that cell. Each piece has a
+ * Gets one row of the window around an overhang cell, with bit (TUCK_WINDOW_SIZE - 1 - i) being column (x - TUCK_WINDOW_RADIUS + i).
+ * Cells past the walls and the floor count as filled, and cells above the ceiling count as empty (same as collision()).
+ */
+unsigned int getTuckWindowRow(unsigned int board[20], int x, int y) {
+  if (y < 0) {
+    return 0;
+  }
+  if (y >= 20) {
+    return (1 << TUCK_WINDOW_SIZE) - 1;
+  }
+  // Pad the row with walls on both sides, such that column c is at bit (9 + TUCK_WINDOW_RADIUS - c)
+  unsigned int wallBits = (1 << TUCK_WINDOW_RADIUS) - 1;
+  unsigned int paddedRow = (wallBits << (10 + TUCK_WINDOW_RADIUS)) | ((board[y] & FULL_ROW) << TUCK_WINDOW_RADIUS) | wallBits;
+  return (paddedRow >> (9 - x)) & ((1 << TUCK_WINDOW_SIZE) - 1);
+}
+
+/**
+   Searches for tucks by 1) Finding all of the overhang cells from the board array, then 2) looking up which of the
+   ways that the piece could possibly fill that cell fit into the board around it. Each piece has a
    precomputed list of the possible ways it can fill a tuck cell (defined in tetrominoes.h), which drastically
    reduces the number of placements to try each time.
+   Tucks that lock in a spot that's already in lockSpots are skipped, since a standard placement (or another tuck)
+   already gets there with simpler inputs.
  */
 void findTucks(unsigned int board[20],
                const Piece *piece,
                int availableTuckCols[40],
                int minTuckYValsByNumPrevInputs[7],
-               OUT std::vector<LockPlacement> &lockPlacements) {
-  std::vector<LockPlacement> tuckLockPlacements;
-  std::unordered_set<int> tuckLockSpots;
+               OUT std::bitset<LOCK_SPOT_RANGE> &lockSpots,
+               OUT LockPlacementList &lockPlacements) {
   for (int overhangY = 0; overhangY < 20; overhangY++) {
     if ((board[overhangY] & ALL_TUCK_SETUP_BITS) == 0) {
       continue;
@@ -310,28 +629,35 @@ void findTucks(unsigned int board[20],
       if ((board[overhangY] & TUCK_SETUP_BIT(overhangX)) > 0) {
         // Found an overhang cell! Look for tucks here
         maybePrint("Looking for tucks at %d %d\n", overhangX, overhangY);
+        // The piece must fit into the board post-tuck
+        unsigned int fittingSpots = 0xFF;
+        for (int windowRow = 0; windowRow < TUCK_WINDOW_SIZE && fittingSpots != 0; windowRow++) {
+          unsigned int windowBits = getTuckWindowRow(board, overhangX, overhangY - TUCK_WINDOW_RADIUS + windowRow);
+          fittingSpots &= TUCK_FIT_TABLE[piece->index][windowRow][windowBits];
+        }
+        int spotIndex = -1;
         for (TuckOriginSpot spot : TUCK_SPOTS_LIST[piece->index]) {
+          spotIndex++;
           int pieceX = overhangX - spot.x;
           int postTuckPieceY = overhangY - spot.y;
           int lockPieceY = postTuckPieceY; // Can differ from postTuckPieceY if the piece falls after the tuck
           maybePrint("Trying origin spot %d %d %d\n", spot.orientation, spot.x, spot.y);
-          // The piece must fit into the board post-tuck
-          if (!collision(board, piece, pieceX, postTuckPieceY, spot.orientation)) {
+          if (fittingSpots & (1 << spotIndex)) {
             maybePrint("Fits into board\n");
             // Found a new tuck! Gravity it down if needed
             while (!collision(board, piece, pieceX, lockPieceY + 1, spot.orientation)) {
               lockPieceY++;
             }
 
-            int lockPositionHash = lockPieceY * 1000 + pieceX * 10 + spot.orientation;
-            if (tuckLockSpots.find(lockPositionHash) == tuckLockSpots.end()) {
+            int lockPositionIndex = LOCK_SPOT_INDEX(pieceX, lockPieceY, spot.orientation);
+            if (!lockSpots[lockPositionIndex]) {
               char c = findTuckInput(board,
                                      {pieceX, postTuckPieceY, spot.orientation, -1, -1, piece},
                                      availableTuckCols,
                                      minTuckYValsByNumPrevInputs);
               if (c != NO_TUCK_NOTATION) {
                 lockPlacements.push_back({pieceX, lockPieceY, spot.orientation, -1, c, piece});
-                tuckLockSpots.insert(lockPositionHash);
+                lockSpots[lockPositionIndex] = true;
               }
             }
           }
@@ -341,25 +667,46 @@ void findTucks(unsigned int board[20],
   }
 }
 
+/** Checks if a board's stack is low enough that the piece finds the same midair placements as on an empty board. */
+bool isBelowTrajectories(GameState const &gameState, const Piece *piece, const MoveSearchTemplate *moveTemplate) {
+  int maxHeight = 0;
+  for (int i = 0; i < 10; i++) {
+    maxHeight = max(maxHeight, gameState.surfaceArray[i]);
+  }
+  return maxHeight <= moveTemplate->maxUnreachableStackHeight[piece->index];
+}
+
 /**
  * Main move search implementation.
  * Wrapped in two parent functions depending on whether the move search is from standard spawn or from a midair adjustment spot.
+ * @param moveTemplate - precomputed trajectories to replay instead of simulating frames. Only valid when searching from spawn, otherwise NULL.
  */
 int moveSearchInternal(GameState gameState,
                        SimState spawnState,
                        const Piece *piece,
-                       char const *inputFrameTimeline,
-                       OUT std::vector<LockPlacement> &lockPlacements) {
-  vector<SimState> legalMidairPlacements;
+                       InputTimeline const &inputTimeline,
+                       const MoveSearchTemplate *moveTemplate,
+                       OUT LockPlacementList &lockPlacements) {
+  SimStateList legalMidairPlacements;
   int gravity = getGravity(gameState.level);
   bool gravityDoubled = isGravityDoubled(gameState.level);
 
   // Encodes which rotation/column pairs are reachable, and stores the lowest Y value reached in that pair
   int availableTuckCols[40] = {};
   int minTuckYValsByNumPrevInputs[7] = {};
-  computeYValueOfEachShift(inputFrameTimeline, gravity, gravityDoubled, piece->initialY, minTuckYValsByNumPrevInputs);
+  if (moveTemplate != NULL) {
+    memcpy(minTuckYValsByNumPrevInputs, moveTemplate->minTuckYValsByNumPrevInputs[piece->index], sizeof(minTuckYValsByNumPrevInputs));
+  } else {
+    computeYValueOfEachShift(inputTimeline, gravity, gravityDoubled, piece->initialY, minTuckYValsByNumPrevInputs);
+  }
+
+  // Low stacks don't block any inputs, so there's nothing to simulate
+  bool isLowStack = moveTemplate != NULL && isBelowTrajectories(gameState, piece, moveTemplate);
+  if (isLowStack) {
+    legalMidairPlacements = moveTemplate->emptyBoardPlacements[piece->index];
+  }
 
-  for (int goalRotIndex = 0; goalRotIndex < 4; goalRotIndex++) {
+  for (int goalRotIndex = 0; goalRotIndex < 4 && !isLowStack; goalRotIndex++) {
     if (piece->rowsByRotation[goalRotIndex][0] == NONE) {
       // Rotation doesn't exist on this piece
       debugPrint("Rotation doesn't exist\n");
@@ -379,69 +726,338 @@ int moveSearchInternal(GameState gameState,
       legalMidairPlacements.push_back(spawnState);
     }
 
+    if (moveTemplate != NULL) {
+      for (auto const &trajectory : moveTemplate->trajectories[piece->index][goalRotIndex]) {
+        replayTrajectory(gameState.board, piece, trajectory, legalMidairPlacements);
+      }
+      continue;
+    }
+
     // Search for placements as far as possible to both sides
     exploreHorizontally(gameState.board,
                         spawnState,
                         -1,
                         -99,
                         goalRotIndex,
-                        inputFrameTimeline,
+                        inputTimeline,
                         gravity,
                         gravityDoubled,
                         legalMidairPlacements,
-                        availableTuckCols);
+                        availableTuckCols,
+                        /* trajectory= */ NULL);
     exploreHorizontally(gameState.board,
                         spawnState,
                         1,
                         99,
                         goalRotIndex,
-                        inputFrameTimeline,
+                        inputTimeline,
                         gravity,
                         gravityDoubled,
                         legalMidairPlacements,
-                        availableTuckCols);
+                        availableTuckCols,
+                        /* trajectory= */ NULL);
     // Then double check for some we missed near spawn
     explorePlacementsNearSpawn(gameState.board,
                                spawnState,
                                goalRotIndex,
-                               inputFrameTimeline,
+                               inputTimeline,
                                gravity,
                                gravityDoubled,
                                legalMidairPlacements,
-                               availableTuckCols);
+                               availableTuckCols,
+                               /* trajectories= */ NULL);
   }
 
   // Let the pieces fall until they lock
+  std::bitset<LOCK_SPOT_RANGE> lockSpots;
   getLockPlacementsFast(
-    legalMidairPlacements, gameState.board, gameState.surfaceArray, availableTuckCols, lockPlacements);
+    legalMidairPlacements, gameState.board, gameState.surfaceArray, availableTuckCols, lockSpots, lockPlacements);
 
   // Search for tucks
   if (CAN_TUCK) {
-    findTucks(gameState.board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, lockPlacements);
+    findTucks(gameState.board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, lockSpots, lockPlacements);
   }
 
   return (int)lockPlacements.size();
 }
 
+/**
+ * Batched version of moveSearchInternal() for searches from spawn, replaying each trajectory against several boards at once.
+ * Produces the same placements, in the same order, as searching each board separately.
+ */
+void moveSearchInternalBatch(GameState *gameStates[],
+                             int numStates,
+                             const Piece *piece,
+                             const MoveSearchTemplate *moveTemplate,
+                             OUT LockPlacementList *lockPlacementsByState[]) {
+  BoardBatch batch = {};
+  SimStateList legalMidairPlacements[MOVE_SEARCH_BATCH_SIZE];
+  SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+
+  // Boards where the piece collides on spawn have no placements, and low stacks don't need replaying, so both sit out of the batch
+  unsigned int activeLanes = 0;
+  unsigned int lowStackLanes = 0;
+  for (int lane = 0; lane < numStates; lane++) {
+    for (int row = 0; row < 20; row++) {
+      batch.rows[row][lane] = gameStates[lane]->board[row];
+    }
+    if (isBelowTrajectories(*gameStates[lane], piece, moveTemplate)) {
+      // Low stacks get the empty board placements without replaying anything (see moveSearchInternal)
+      legalMidairPlacements[lane] = moveTemplate->emptyBoardPlacements[piece->index];
+      lowStackLanes |= 1U << lane;
+    } else if (!collision(gameStates[lane]->board, piece, spawnState.x, spawnState.y, spawnState.rotationIndex)) {
+      activeLanes |= 1U << lane;
+      // The starting state is a legal placement
+      legalMidairPlacements[lane].push_back(spawnState);
+    }
+  }
+
+  for (int goalRotIndex = 0; goalRotIndex < 4 && activeLanes != 0; goalRotIndex++) {
+    for (auto const &trajectory : moveTemplate->trajectories[piece->index][goalRotIndex]) {
+      replayTrajectoryBatch(batch, activeLanes, piece, trajectory, legalMidairPlacements);
+    }
+  }
+  activeLanes |= lowStackLanes;
+
+  int minTuckYValsByNumPrevInputs[7] = {};
+  memcpy(minTuckYValsByNumPrevInputs, moveTemplate->minTuckYValsByNumPrevInputs[piece->index], sizeof(minTuckYValsByNumPrevInputs));
+  for (int lane = 0; lane < numStates; lane++) {
+    if (!(activeLanes & (1U << lane))) {
+      continue;
+    }
+    int availableTuckCols[40] = {};
+    std::bitset<LOCK_SPOT_RANGE> lockSpots;
+    getLockPlacementsFast(legalMidairPlacements[lane], gameStates[lane]->board, gameStates[lane]->surfaceArray, availableTuckCols, lockSpots, *lockPlacementsByState[lane]);
+    if (CAN_TUCK) {
+      findTucks(gameStates[lane]->board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, lockSpots, *lockPlacementsByState[lane]);
+    }
+  }
+}
+
+/**
+ * A direct-mapped cache of move search results, keyed on everything the search depends on.
+ * The board (incl. the tuck setup bits) and surface are stored in full, so a hash collision can never return the wrong placements.
+ */
+struct MoveSearchCacheEntry {
+  bool isValid;
+  MoveSearchEngine moveSearchEngine;
+  const MoveSearchTemplate *moveTemplate; // Uniquely identifies the input timeline and gravity
+  int pieceIndex;
+  unsigned int board[20];
+  int surfaceArray[10];
+  vector<LockPlacement> lockPlacements;
+};
+
+#define MOVE_SEARCH_CACHE_SIZE 4096 // Must be a power of 2
+
+// Each thread gets its own table, so lookups never need to lock
+thread_local MoveSearchCacheEntry moveSearchCache[MOVE_SEARCH_CACHE_SIZE];
+std::atomic<long long> moveSearchCacheHits(0);
+std::atomic<long long> moveSearchCacheMisses(0);
+
+unsigned int getMoveSearchCacheIndex(GameState const &gameState, MoveSearchEngine moveSearchEngine, const MoveSearchTemplate *moveTemplate, int pieceIndex) {
+  unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+  for (int i = 0; i < 20; i++) {
+    hash = (hash ^ gameState.board[i]) * 1099511628211ULL;
+  }
+  hash = (hash ^ (unsigned long long) (size_t) moveTemplate) * 1099511628211ULL;
+  hash = (hash ^ pieceIndex) * 1099511628211ULL;
+  hash = (hash ^ moveSearchEngine) * 1099511628211ULL;
+  return (unsigned int) (hash ^ (hash >> 32)) & (MOVE_SEARCH_CACHE_SIZE - 1);
+}
+
+bool isMoveSearchCacheMatch(MoveSearchCacheEntry const &entry, GameState const &gameState, MoveSearchEngine moveSearchEngine, const MoveSearchTemplate *moveTemplate, int pieceIndex) {
+  if (!entry.isValid || entry.moveSearchEngine != moveSearchEngine || entry.moveTemplate != moveTemplate || entry.pieceIndex != pieceIndex) {
+    return false;
+  }
+  for (int i = 0; i < 20; i++) {
+    if (entry.board[i] != gameState.board[i]) {
+      return false;
+    }
+  }
+  for (int i = 0; i < 10; i++) {
+    if (entry.surfaceArray[i] != gameState.surfaceArray[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Runs whichever move search engine the context asks for, from the standard spawn position. */
+int moveSearchUncached(GameState gameState,
+                       const Piece *piece,
+                       PieceRangeContext const &pieceRangeContext,
+                       const MoveSearchTemplate *moveTemplate,
+                       OUT LockPlacementList &lockPlacements) {
+  if (pieceRangeContext.moveSearchEngine == FLOOD_FILL) {
+    return floodFillSearch(gameState, piece, pieceRangeContext.inputTimeline, lockPlacements);
+  }
+  SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+  return moveSearchInternal(gameState, spawnState, piece, pieceRangeContext.inputTimeline, moveTemplate, lockPlacements);
+}
+
+/**
+ * Copies the cached placements for a search into the output list, if there are any.
+ * @returns whether the cache had the search
+ */
+bool lookUpMoveSearchCache(GameState const &gameState,
+                           const Piece *piece,
+                           MoveSearchEngine engine,
+                           const MoveSearchTemplate *moveTemplate,
+                           OUT LockPlacementList &lockPlacements) {
+  MoveSearchCacheEntry &entry = moveSearchCache[getMoveSearchCacheIndex(gameState, engine, moveTemplate, piece->index)];
+  if (!isMoveSearchCacheMatch(entry, gameState, engine, moveTemplate, piece->index)) {
+    moveSearchCacheMisses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  moveSearchCacheHits.fetch_add(1, std::memory_order_relaxed);
+  for (LockPlacement lockPlacement : entry.lockPlacements) {
+    lockPlacement.piece = piece; // The cached placements may point to a different copy of the same piece
+    lockPlacements.push_back(lockPlacement);
+  }
+  return true;
+}
+
+/** Caches the placements that a search added to the end of a list. */
+void storeInMoveSearchCache(GameState const &gameState,
+                            const Piece *piece,
+                            MoveSearchEngine engine,
+                            const MoveSearchTemplate *moveTemplate,
+                            LockPlacementList const &lockPlacements,
+                            int numExisting) {
+  MoveSearchCacheEntry &entry = moveSearchCache[getMoveSearchCacheIndex(gameState, engine, moveTemplate, piece->index)];
+  // Overwrite whatever was in this slot
+  entry.isValid = true;
+  entry.moveSearchEngine = engine;
+  entry.moveTemplate = moveTemplate;
+  entry.pieceIndex = piece->index;
+  for (int i = 0; i < 20; i++) {
+    entry.board[i] = gameState.board[i];
+  }
+  for (int i = 0; i < 10; i++) {
+    entry.surfaceArray[i] = gameState.surfaceArray[i];
+  }
+  entry.lockPlacements.assign(lockPlacements.begin() + numExisting, lockPlacements.end());
+}
+
 int moveSearch(GameState gameState,
                const Piece *piece,
-               char const *inputFrameTimeline,
-               OUT std::vector<LockPlacement> &lockPlacements) {
-  SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
-  return moveSearchInternal(gameState, spawnState, piece, inputFrameTimeline, lockPlacements);
+               PieceRangeContext const &pieceRangeContext,
+               OUT LockPlacementList &lockPlacements) {
+  MoveSearchEngine engine = pieceRangeContext.moveSearchEngine;
+  const MoveSearchTemplate *moveTemplate = getMoveSearchTemplate(pieceRangeContext.inputTimeline, getGravity(gameState.level), isGravityDoubled(gameState.level));
+  if (!USE_MOVE_SEARCH_CACHE || moveTemplate == NULL) {
+    return moveSearchUncached(gameState, piece, pieceRangeContext, moveTemplate, lockPlacements);
+  }
+
+  int numExisting = lockPlacements.size();
+  if (lookUpMoveSearchCache(gameState, piece, engine, moveTemplate, lockPlacements)) {
+    return lockPlacements.size() - numExisting;
+  }
+  int numFound = moveSearchUncached(gameState, piece, pieceRangeContext, moveTemplate, lockPlacements);
+  storeInMoveSearchCache(gameState, piece, engine, moveTemplate, lockPlacements, numExisting);
+  return numFound;
+}
+
+bool isSameBoard(GameState const &a, GameState const &b) {
+  for (int i = 0; i < 20; i++) {
+    if (a.board[i] != b.board[i]) {
+      return false;
+    }
+  }
+  for (int i = 0; i < 10; i++) {
+    if (a.surfaceArray[i] != b.surfaceArray[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Searches a batch of boards that missed the cache, and caches the results. */
+void searchPendingBatch(GameState *pendingStates[],
+                        LockPlacementList *pendingLists[],
+                        int numPending,
+                        const Piece *piece,
+                        MoveSearchEngine engine,
+                        const MoveSearchTemplate *moveTemplate) {
+  moveSearchInternalBatch(pendingStates, numPending, piece, moveTemplate, pendingLists);
+  if (USE_MOVE_SEARCH_CACHE) {
+    for (int i = 0; i < numPending; i++) {
+      storeInMoveSearchCache(*pendingStates[i], piece, engine, moveTemplate, *pendingLists[i], /* numExisting= */ 0);
+    }
+  }
+}
+
+/**
+ * Searches the same piece on several boards, e.g. every board after the first placement in a depth-2 search.
+ * Equivalent to calling moveSearch() on each board (with empty lists), but the boards that miss the cache are searched
+ * MOVE_SEARCH_BATCH_SIZE at a time (see moveSearchInternalBatch).
+ * The input timeline and engine come from the context, and the gravity from each board's level.
+ */
+void moveSearchBatch(GameState gameStates[],
+                     int numStates,
+                     const Piece *piece,
+                     PieceRangeContext const &pieceRangeContext,
+                     OUT LockPlacementList lockPlacementsByState[]) {
+  MoveSearchEngine engine = pieceRangeContext.moveSearchEngine;
+  GameState *pendingStates[MOVE_SEARCH_BATCH_SIZE];
+  LockPlacementList *pendingLists[MOVE_SEARCH_BATCH_SIZE];
+  const MoveSearchTemplate *pendingTemplate = NULL;
+  int numPending = 0;
+
+  for (int i = 0; i < numStates; i++) {
+    GameState &gameState = gameStates[i];
+    const MoveSearchTemplate *moveTemplate = getMoveSearchTemplate(pieceRangeContext.inputTimeline, getGravity(gameState.level), isGravityDoubled(gameState.level));
+    if (engine == FLOOD_FILL || moveTemplate == NULL) {
+      // Nothing to batch, so search it on its own
+      moveSearch(gameState, piece, pieceRangeContext, lockPlacementsByState[i]);
+      continue;
+    }
+
+    // Search the pending boards if this one can't join them. That includes when it repeats one of them,
+    // since it'll then be in the cache.
+    bool isRepeat = false;
+    for (int j = 0; j < numPending && USE_MOVE_SEARCH_CACHE; j++) {
+      isRepeat = isRepeat || isSameBoard(*pendingStates[j], gameState);
+    }
+    if (numPending == MOVE_SEARCH_BATCH_SIZE || (numPending > 0 && moveTemplate != pendingTemplate) || isRepeat) {
+      searchPendingBatch(pendingStates, pendingLists, numPending, piece, engine, pendingTemplate);
+      numPending = 0;
+    }
+
+    if (USE_MOVE_SEARCH_CACHE && lookUpMoveSearchCache(gameState, piece, engine, moveTemplate, lockPlacementsByState[i])) {
+      continue;
+    }
+    pendingStates[numPending] = &gameState;
+    pendingLists[numPending] = &lockPlacementsByState[i];
+    pendingTemplate = moveTemplate;
+    numPending++;
+  }
+  if (numPending > 0) {
+    searchPendingBatch(pendingStates, pendingLists, numPending, piece, engine, pendingTemplate);
+  }
+}
+
+/** Formats the move search cache counters as JSON, for the binding to report. */
+std::string getMoveSearchCacheStats() {
+  long long hits = moveSearchCacheHits.load(std::memory_order_relaxed);
+  long long misses = moveSearchCacheMisses.load(std::memory_order_relaxed);
+  char buffer[100];
+  snprintf(buffer, 100, "{\"hits\":%lld,\"misses\":%lld}", hits, misses);
+  return std::string(buffer);
 }
 
 int adjustmentSearch(GameState gameState,
                      const Piece *piece,
-                     char const *inputFrameTimeline,
+                     InputTimeline const &inputTimeline,
                      int existingXOffset,
                      int existingYOffset,
                      int existingRotation,
                      int framesAlreadyElapsed,
                      int arrWasReset,
-                     OUT std::vector<LockPlacement> &lockPlacements){
+                     OUT LockPlacementList &lockPlacements){
   SimState startState = {INITIAL_X + existingXOffset, piece->initialY + existingYOffset, existingRotation, framesAlreadyElapsed, /* arrIndex= */ arrWasReset ? 0 : framesAlreadyElapsed, piece};
-  return moveSearchInternal(gameState, startState, piece, inputFrameTimeline, lockPlacements);
+  return moveSearchInternal(gameState, startState, piece, inputTimeline, /* moveTemplate= */ NULL, lockPlacements);
 }
 
 /* ----------- TESTS ----------- */
@@ -514,8 +1130,8 @@ int testAdjustmentSearch(int testCase[4]){
     printBoardWithPiece(gameState.board, PIECE_T, SPAWN_X + xOffset, PIECE_T.initialY + yOffset, rotation);
   }
 
-  std::vector<LockPlacement> lockPlacements;
-  int adjCount = adjustmentSearch(gameState, &PIECE_T, "X...", xOffset, yOffset, rotation, framesElapsed, arrReset, lockPlacements);
+  LockPlacementList lockPlacements;
+  int adjCount = adjustmentSearch(gameState, &PIECE_T, compileInputTimeline("X..."), xOffset, yOffset, rotation, framesElapsed, arrReset, lockPlacements);
   if (MOVE_SEARCH_DEBUG_LOGGING) {
     for (auto state : lockPlacements) {
       if (MOVE_SEARCH_DEBUG_LOGGING) {
@@ -536,3 +1152,74 @@ void testAdjustments(){
   // int singleTestCase[4] = {2, 8, 3, 33};
   // printf("\n\n\n%d\n", testAdjustmentSearch(singleTestCase));
 }
+
+/**
+ * Times the batched move search against searching the same boards one at a time (bypassing the cache for both),
+ * and checks that they find the same placements.
+ * @returns the number of (board, piece) pairs where the two disagreed
+ */
+int benchmarkMoveSearchBatch(unsigned int boards[][20], int numBoards, int level, char const *inputFrameTimeline, int iterations) {
+  InputTimeline inputTimeline = compileInputTimeline(inputFrameTimeline);
+  const MoveSearchTemplate *moveTemplate = getMoveSearchTemplate(inputTimeline, getGravity(level), isGravityDoubled(level));
+  if (moveTemplate == NULL) {
+    printf("No move search template for this timeline\n");
+    return 0;
+  }
+  std::vector<GameState> gameStates(numBoards);
+  for (int i = 0; i < numBoards; i++) {
+    gameStates[i] = {{}, {}, 0, 0, 0, level};
+    copyBoard(boards[i], gameStates[i].board);
+    getSurfaceArray(gameStates[i].board, gameStates[i].surfaceArray);
+    updateSurfaceAndHoles(gameStates[i].surfaceArray, gameStates[i].board, /* wellColumn= */ 9, /* isDigMode= */ false);
+  }
+  // Results are kept per piece and board, so the last iteration can be compared
+  std::vector<LockPlacementList> scalarResults(7 * numBoards);
+  std::vector<LockPlacementList> batchResults(7 * numBoards);
+
+  auto scalarStart = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; iter++) {
+    for (int p = 0; p < 7; p++) {
+      const Piece *piece = &PIECE_LIST[p];
+      SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+      for (int i = 0; i < numBoards; i++) {
+        LockPlacementList &result = scalarResults[p * numBoards + i];
+        result.clear();
+        moveSearchInternal(gameStates[i], spawnState, piece, inputTimeline, moveTemplate, result);
+      }
+    }
+  }
+  auto batchStart = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; iter++) {
+    for (int p = 0; p < 7; p++) {
+      for (int i = 0; i < numBoards; i += MOVE_SEARCH_BATCH_SIZE) {
+        GameState *statePtrs[MOVE_SEARCH_BATCH_SIZE];
+        LockPlacementList *listPtrs[MOVE_SEARCH_BATCH_SIZE];
+        int batchSize = std::min(MOVE_SEARCH_BATCH_SIZE, numBoards - i);
+        for (int b = 0; b < batchSize; b++) {
+          statePtrs[b] = &gameStates[i + b];
+          listPtrs[b] = &batchResults[p * numBoards + i + b];
+          listPtrs[b]->clear();
+        }
+        moveSearchInternalBatch(statePtrs, batchSize, &PIECE_LIST[p], moveTemplate, listPtrs);
+      }
+    }
+  }
+  auto batchEnd = std::chrono::steady_clock::now();
+
+  int numMismatched = 0;
+  for (int i = 0; i < 7 * numBoards; i++) {
+    bool isMatch = scalarResults[i].size() == batchResults[i].size();
+    for (int j = 0; isMatch && j < scalarResults[i].size(); j++) {
+      LockPlacement const &a = scalarResults[i][j];
+      LockPlacement const &b = batchResults[i][j];
+      isMatch = a.x == b.x && a.y == b.y && a.rotationIndex == b.rotationIndex && a.tuckInput == b.tuckInput && a.tuckFrame == b.tuckFrame;
+    }
+    numMismatched += isMatch ? 0 : 1;
+  }
+
+  long long scalarMicros = std::chrono::duration_cast<std::chrono::microseconds>(batchStart - scalarStart).count();
+  long long batchMicros = std::chrono::duration_cast<std::chrono::microseconds>(batchEnd - batchStart).count();
+  printf("Move search on %d boards x 7 pieces x %d iterations: scalar %lldus, batched %lldus (%.2fx), %d mismatched\n",
+         numBoards, iterations, scalarMicros, batchMicros, batchMicros == 0 ? 0.0 : (double) scalarMicros / batchMicros, numMismatched);
+  return numMismatched;
+}
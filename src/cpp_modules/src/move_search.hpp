@@ -5,16 +5,22 @@
 #include "utils.hpp"
 #include <vector>
 
-int moveSearch(GameState gameState, const Piece *piece, char const *inputFrameTimeline, OUT std::vector<LockPlacement> &lockPlacements, OUT int availableTuckCols[40]);
+int moveSearch(GameState gameState, const Piece *piece, PieceRangeContext const &pieceRangeContext, OUT LockPlacementList &lockPlacements);
+
+void moveSearchBatch(GameState gameStates[],
+                     int numStates,
+                     const Piece *piece,
+                     PieceRangeContext const &pieceRangeContext,
+                     OUT LockPlacementList lockPlacementsByState[]);
 
 int adjustmentSearch(GameState gameState,
                      const Piece *piece,
-                     char const *inputFrameTimeline,
+                     InputTimeline const &inputTimeline,
                      int existingXOffset,
                      int existingYOffset,
                      int existingRotation,
                      int framesAlreadyElapsed,
                      int arrWasReset,
-                     OUT std::vector<LockPlacement> &lockPlacements);
+                     OUT LockPlacementList &lockPlacements);
 
 #endif
@@ -1,22 +1,26 @@
 #include "piece_ranges.hpp"
 
-xtable getRangeXTable() {
-  xtable table = {};
+masktable getPieceMaskTable() {
+  masktable table = {};
   for (int p = 0; p < 7; p++) {
     for (int rot = 0; rot < 4; rot++) {
-      for (int x = -3; x <= 8;
-           x++) { // Lowest possible x is -2, highest possible is 7. Then one extra on either side.
-        int tableX = x + X_BOUNDS_COLLISION_TABLE_OFFSET;
-        table[p][rot][tableX] = 0; // No collision by default
+      for (int x = -PIECE_MASK_TABLE_OFFSET; x < PIECE_MASK_TABLE_WIDTH - PIECE_MASK_TABLE_OFFSET; x++) {
+        PieceMask &mask = table[p][rot][x + PIECE_MASK_TABLE_OFFSET];
+        bool inBounds = true;
         for (int row = 0; row < 4; row++) {
-          if (SHIFTBY(PIECE_LIST[p].rowsByRotation[rot][row], x) >= 1024) {
-            table[p][rot][tableX] = 1; // Mark the collision
-            break;
-          }
-          if (SHIFTBY(PIECE_LIST[p].rowsByRotation[rot][row], x - 1) & 1) {
-            table[p][rot][tableX] = 1; // Mark the collision
+          unsigned int pieceRow = PIECE_LIST[p].rowsByRotation[rot][row];
+          unsigned int shiftedRow = SHIFTBY(pieceRow, x);
+          // Rotations that don't exist on this piece, or cells that fall off the left or right of the board
+          if (pieceRow == NONE || shiftedRow > FULL_ROW || SHIFTBY(shiftedRow, -x) != pieceRow) {
+            inBounds = false;
             break;
           }
+          mask.rows[row] = shiftedRow;
+        }
+        if (!inBounds) {
+          mask = {{0, 0, 0, 0}, -99}; // Collides at every y value
+        } else {
+          mask.maxY = PIECE_LIST[p].maxYByRotation[rot];
         }
       }
     }
@@ -24,18 +28,18 @@ xtable getRangeXTable() {
   return table;
 }
 
-const xtable X_BOUNDS_COLLISION_TABLE = getRangeXTable();
+const masktable PIECE_MASK_TABLE = getPieceMaskTable();
 
 /**
  * Calculates a lookup table for the Y value you'd be at while doing shift number N.
  * This is used in the tuck search, since this would be the first Y value where you could perform a tuck after N inputs of a standard placement.
  */
-void computeYValueOfEachShift(char const *inputFrameTimeline, int gravity, bool gravityDoubled, int initialY, OUT int result[7]){
+void computeYValueOfEachShift(InputTimeline const &inputTimeline, int gravity, bool gravityDoubled, int initialY, OUT int result[7]){
   int inputsPerformed = 0;
   int y = initialY;
   int frameIndex = 0;
   while (inputsPerformed <= 5) {
-    int isInputFrame = shouldPerformInputsThisFrame(frameIndex, inputFrameTimeline);
+    int isInputFrame = shouldPerformInputsThisFrame(frameIndex, inputTimeline);
     int isGravityFrame =
       frameIndex % gravity == gravity - 1;   // Returns true every Nth frame, where N = gravity
     if (isInputFrame) {
@@ -49,11 +53,12 @@ void computeYValueOfEachShift(char const *inputFrameTimeline, int gravity, bool
   }
 }
 
-const PieceRangeContext getPieceRangeContext(char const *inputFrameTimeline, int gravity, bool gravityDoubled){
+const PieceRangeContext getPieceRangeContext(InputTimeline const &inputTimeline, MoveSearchEngine moveSearchEngine, int gravity, bool gravityDoubled){
   PieceRangeContext context = {};
   
-  context.inputFrameTimeline = inputFrameTimeline;
-  computeYValueOfEachShift(inputFrameTimeline, gravity, gravityDoubled, -1, OUT context.yValueOfEachShift);
+  context.inputTimeline = inputTimeline;
+  context.moveSearchEngine = moveSearchEngine;
+  computeYValueOfEachShift(inputTimeline, gravity, gravityDoubled, -1, OUT context.yValueOfEachShift);
   context.max4TapHeight = 17 - context.yValueOfEachShift[4]; // 17 is the surface height of a square/long bar when y=0
   context.max5TapHeight = 17 - context.yValueOfEachShift[5];
   
@@ -5,19 +5,30 @@
 
 using namespace std;
 
-#define X_BOUNDS_COLLISION_TABLE_OFFSET 3
+#define PIECE_MASK_TABLE_OFFSET 4 // The lowest X value in the table is -4
+#define PIECE_MASK_TABLE_WIDTH 16
 
-typedef array<array<array<int, 12>, 4>, 7> xtable;
+/**
+ * The footprint of one piece in one rotation at one X position, already shifted into board coordinates.
+ * Placements that poke out of the sides of the board are folded into maxY, such that
+ * (y > maxY) covers both the walls and the floor.
+ */
+struct PieceMask {
+  unsigned int rows[4];
+  int maxY;
+};
+
+typedef array<array<array<PieceMask, PIECE_MASK_TABLE_WIDTH>, 4>, 7> masktable;
 
-extern const xtable X_BOUNDS_COLLISION_TABLE;
+extern const masktable PIECE_MASK_TABLE;
 
 /**
  * Calculates a lookup table for the Y value you'd be at while doing shift number N.
  * This is used in the tuck search, since this would be the first Y value where you could perform a tuck after N inputs of a standard placement.
  */
-void computeYValueOfEachShift(char const *inputFrameTimeline, int gravity, bool gravityDoubled, int initialY, OUT int result[7]);
+void computeYValueOfEachShift(InputTimeline const &inputTimeline, int gravity, bool gravityDoubled, int initialY, OUT int result[7]);
 
-const PieceRangeContext getPieceRangeContext(char const *inputFrameTimeline, int gravity, bool gravityDoubled);
+const PieceRangeContext getPieceRangeContext(InputTimeline const &inputTimeline, MoveSearchEngine moveSearchEngine, int gravity, bool gravityDoubled);
 
 
 #endif
@@ -1,7 +1,9 @@
 #include "playout.hpp"
 #include "eval.hpp"
+#include "eval_context.hpp"
 #include "utils.hpp"
 #include "params.hpp"
+#include "thread_pool.hpp"
 #include "../data/canonical_sequences.hpp"
 
 using namespace std;
@@ -9,15 +11,24 @@ using namespace std;
 /** Selects the highest value lock placement using the fast eval function. */
 LockPlacement pickLockPlacement(GameState gameState,
                                 const EvalContext *evalContext,
-                                OUT vector<LockPlacement> &lockPlacements) {
+                                OUT LockPlacementList &lockPlacements) {
   float bestSoFar = evalContext->weights.deathCoef - 1;
   LockPlacement bestPlacement = {};
-  for (auto lockPlacement : lockPlacements) {
-    GameState newState = advanceGameState(gameState, lockPlacement, evalContext);
-    float evalScore = fastEval(gameState, newState, lockPlacement, evalContext);
-    if (evalScore > bestSoFar) {
-      bestSoFar = evalScore;
-      bestPlacement = lockPlacement;
+  SurfaceFeatures surfaceFeatures = getSurfaceFeatures(gameState.surfaceArray, evalContext);
+  // Placements are evaluated in batches (see fastEvalBatch)
+  GameState newStates[EVAL_BATCH_SIZE];
+  float evalScores[EVAL_BATCH_SIZE];
+  for (int i = 0; i < lockPlacements.size(); i += EVAL_BATCH_SIZE) {
+    int batchSize = std::min(EVAL_BATCH_SIZE, (int) lockPlacements.size() - i);
+    for (int b = 0; b < batchSize; b++) {
+      newStates[b] = advanceGameState(gameState, lockPlacements[i + b], evalContext);
+    }
+    fastEvalBatch(gameState, surfaceFeatures, newStates, &lockPlacements[i], batchSize, evalContext, evalScores);
+    for (int b = 0; b < batchSize; b++) {
+      if (evalScores[b] > bestSoFar) {
+        bestSoFar = evalScores[b];
+        bestPlacement = lockPlacements[i + b];
+      }
     }
   }
   maybePrint("\nBest placement: %d %d\n", bestPlacement.rotationIndex, bestPlacement.x - SPAWN_X);
@@ -26,127 +37,491 @@ LockPlacement pickLockPlacement(GameState gameState,
 
 
 /**
- * Plays out a starting state N moves into the future.
- * @returns the total value of the playout (intermediate rewards + eval of the final board)
+ * One playout in progress. Playouts are played in lockstep (see getPlayoutScore), so everything that carries over
+ * from one move to the next lives here.
  */
-float playSequence(GameState gameState, const PieceRangeContext pieceRangeContextLookup[3], const int pieceSequence[SEQUENCE_LENGTH], int playoutLength, OUT vector<PlayoutData> *playoutDataList) {
-  // Note down the original AI mode to prevent the AI from putting itself in alternate modes to affect the valuations
-  AiMode originalAiMode = getEvalContext(gameState, pieceRangeContextLookup).aiMode;
-  
-  PlayoutData newPlayoutData;
-  const bool trackPlayouts = TRACK_PLAYOUT_DETAILS && playoutDataList != NULL;
+struct PlayoutState {
+  GameState gameState;
+  const int *pieceSequence;
+  const EvalContext *evalContext; // Points into the request's EvalContextLookup
+  float totalReward;
+  bool isFinished;
+  float score; // Only valid once finished
+  bool hasPlayoutData; // Whether the playout data should be reported once all the playouts are done
+  PlayoutData playoutData;
+};
 
-  float totalReward = 0;
-  for (int i = 0; i < playoutLength; i++) {
-    // Figure out modes and eval context
-    const EvalContext evalContextRaw = getEvalContext(gameState, pieceRangeContextLookup);
-    const EvalContext *evalContext = &evalContextRaw;
-    FastEvalWeights weights = getWeights(evalContext->aiMode);
-
-    // Get the lock placements
-    std::vector<LockPlacement> lockPlacements;
-    Piece piece = PIECE_LIST[pieceSequence[i]];
-    moveSearch(gameState, &piece, evalContext->pieceRangeContext.inputFrameTimeline, lockPlacements);
-
-    if (lockPlacements.size() == 0) {
-      return weights.deathCoef;
-    }
-
-    // Pick the best placement
-    LockPlacement bestMove = pickLockPlacement(gameState, evalContext, lockPlacements);
-    if (trackPlayouts){
-      LockLocation bestMoveLocation = { bestMove.x, bestMove.y, bestMove.rotationIndex };
-      newPlayoutData.pieceSequence += getPieceChar(piece.index);
-      newPlayoutData.placements.push_back(bestMoveLocation);
-    }
-
-    // On the last move, do a final evaluation
-    if (i == playoutLength - 1) {
-      GameState nextState = advanceGameState(gameState, bestMove, evalContext);
-      
-      if (SHOULD_PLAY_PERFECT){
-        float eval = evalForPerfectPlay(gameState, nextState, bestMove, evalContext);
-        if (trackPlayouts){
-          newPlayoutData.totalScore = totalReward + eval;
-          copyBoard(nextState.board, newPlayoutData.resultingBoard);
-          insertIntoList(newPlayoutData, playoutDataList);
-        }
-        return eval;
+/**
+ * Plays one move of a playout, given the lock placements for the current piece.
+ * Once the playout reaches its last move (or dies), it's marked as finished with the total value of the playout
+ * (intermediate rewards + eval of the final board).
+ */
+void playSequenceStep(PlayoutState &playout, int i, int playoutLength, AiMode originalAiMode, const Piece *piece, OUT LockPlacementList &lockPlacements, bool trackPlayouts) {
+  GameState &gameState = playout.gameState;
+  const EvalContext *evalContext = playout.evalContext;
+  FastEvalWeights const &weights = evalContext->weights;
+
+  if (lockPlacements.size() == 0) {
+    playout.isFinished = true;
+    playout.score = weights.deathCoef;
+    return;
+  }
+
+  // Pick the best placement
+  LockPlacement bestMove = pickLockPlacement(gameState, evalContext, lockPlacements);
+  if (trackPlayouts){
+    LockLocation bestMoveLocation = { bestMove.x, bestMove.y, bestMove.rotationIndex };
+    playout.playoutData.pieceSequence += getPieceChar(piece->index);
+    playout.playoutData.placements.push_back(bestMoveLocation);
+  }
+
+  // On the last move, do a final evaluation
+  if (i == playoutLength - 1) {
+    GameState nextState = advanceGameState(gameState, bestMove, evalContext);
+    playout.isFinished = true;
+
+    if (SHOULD_PLAY_PERFECT){
+      float eval = evalForPerfectPlay(gameState, nextState, bestMove, evalContext);
+      if (trackPlayouts){
+        playout.playoutData.totalScore = playout.totalReward + eval;
+        copyBoard(nextState.board, playout.playoutData.resultingBoard);
+        playout.hasPlayoutData = true;
       }
-      
-      // In some contexts, override the current aiMode such that the end of a playout is always compared fairly against other playouts
+      playout.score = eval;
+      return;
+    }
+
+    // In some contexts, override the current aiMode such that the end of a playout is always compared fairly against other playouts
+    float evalScore;
+    if ((originalAiMode == DIG || originalAiMode == STANDARD) && originalAiMode != evalContext->aiMode){
       EvalContext contextRaw = *evalContext;
-      if (originalAiMode == DIG || originalAiMode == STANDARD){
-        contextRaw.aiMode = originalAiMode;
+      contextRaw.aiMode = originalAiMode;
+      contextRaw.evalCacheKey = getEvalCacheKey(contextRaw);
+      evalScore = fastEval(gameState, nextState, bestMove, &contextRaw);
+    } else {
+      evalScore = fastEval(gameState, nextState, bestMove, evalContext);
+    }
+    if (PLAYOUT_LOGGING_ENABLED) {
+      printBoard(nextState.board);
+      printf("Best placement: %c %d, %d\n\n", bestMove.piece->id, bestMove.rotationIndex, bestMove.x - SPAWN_X);
+      printf("Cumulative reward: %01f\n", playout.totalReward);
+      printf("Final eval score: %01f\n", evalScore);
+      printf("*** TOTAL= %f ***\n", playout.totalReward + evalScore);
+    }
+    if (trackPlayouts) {
+      playout.playoutData.totalScore = playout.totalReward + evalScore;
+      copyBoard(nextState.board, playout.playoutData.resultingBoard);
+      playout.hasPlayoutData = true;
+    }
+    playout.score = playout.totalReward + evalScore;
+    return;
+  }
+
+  // Otherwise, update the state to keep playing
+  int oldLines = gameState.lines;
+  gameState = advanceGameState(gameState, bestMove, evalContext);
+
+  if (SHOULD_PLAY_PERFECT){
+    if ((gameState.lines - oldLines) % 4 != 0){
+      playout.isFinished = true;
+      playout.score = 0; // 0% chance of continuing perfect
+    }
+  } else {
+    FastEvalWeights rewardWeights = evalContext->aiMode == DIG ? getWeights(STANDARD) : weights; // When the AI is digging, still deduct from the overall value of the sequence at standard amounts
+    playout.totalReward += getLineClearFactor(gameState.lines - oldLines, rewardWeights, evalContext->shouldRewardLineClears);
+    if (PLAYOUT_LOGGING_ENABLED) {
+      printBoard(gameState.board);
+      printf("Best placement: %c %d, %d\n\n", bestMove.piece->id, bestMove.rotationIndex, bestMove.x - SPAWN_X);
+    }
+  }
+}
+
+
+// The lock placements of a batch take up about 260KB, so each thread keeps them here rather than on the stack
+thread_local LockPlacementList batchLockPlacementsScratch[MOVE_SEARCH_BATCH_SIZE];
+
+/** Plays one move of several playouts that all have the same piece next, searching their boards in one batch. */
+void playBatchStep(PlayoutState *batch[], int batchSize, int i, int playoutLength, AiMode originalAiMode, const Piece *piece, bool trackPlayouts) {
+  GameState batchStates[MOVE_SEARCH_BATCH_SIZE];
+  LockPlacementList *batchLockPlacements = batchLockPlacementsScratch;
+  for (int b = 0; b < batchSize; b++) {
+    batchLockPlacements[b].clear();
+  }
+  for (int b = 0; b < batchSize; b++) {
+    batchStates[b] = batch[b]->gameState;
+  }
+  // Get the lock placements. The move search only reads the input timeline and engine from the context, which are the same for every playout.
+  moveSearchBatch(batchStates, batchSize, piece, batch[0]->evalContext->pieceRangeContext, batchLockPlacements);
+  for (int b = 0; b < batchSize; b++) {
+    playSequenceStep(*batch[b], i, playoutLength, originalAiMode, piece, batchLockPlacements[b], trackPlayouts);
+  }
+}
+
+
+/**
+ * Plays a set of playouts to the end. They're played one move at a time, so that the move searches for the same piece
+ * can be batched.
+ */
+void playPlayouts(PlayoutState *playouts[], int numPlayouts, int playoutLength, AiMode originalAiMode, EvalContextLookup const &evalContextLookup, bool trackPlayouts) {
+  // Playouts that have seen the same pieces so far are in the same state, since every move is picked greedily. So the
+  // playouts form a tree of shared prefixes, and only the first playout of each prefix (its leader) plays each move.
+  // The others copy the leader's state afterwards. (For the exhaustive sequences of length 2, the first move is only
+  // played for 7 of the 49 playouts.)
+  vector<int> prefixLeaders(numPlayouts, 0);
+  vector<int> leaderByPiece(numPlayouts * 7);
+
+  PlayoutState *batch[MOVE_SEARCH_BATCH_SIZE];
+  for (int moveIndex = 0; moveIndex < playoutLength; moveIndex++) {
+    // Split each prefix from the previous move by the piece for this move
+    fill(leaderByPiece.begin(), leaderByPiece.end(), -1);
+    for (int i = 0; i < numPlayouts; i++) {
+      int &leader = leaderByPiece[prefixLeaders[i] * 7 + playouts[i]->pieceSequence[moveIndex]];
+      if (leader == -1) {
+        leader = i;
       }
-      float evalScore = fastEval(gameState, nextState, bestMove, &contextRaw);
-      if (PLAYOUT_LOGGING_ENABLED) {
-        gameState = nextState;
-        printBoard(gameState.board);
-        printf("Best placement: %c %d, %d\n\n", bestMove.piece->id, bestMove.rotationIndex, bestMove.x - SPAWN_X);
-        printf("Cumulative reward: %01f\n", totalReward);
-        printf("Final eval score: %01f\n", evalScore);
-        printf("*** TOTAL= %f ***\n", totalReward + evalScore);
+      prefixLeaders[i] = leader;
+    }
+
+    for (int i = 0; i < numPlayouts; i++) {
+      PlayoutState &playout = *playouts[i];
+      if (!playout.isFinished && prefixLeaders[i] == i) {
+        // Figure out the mode, and switch to the eval context for it
+        playout.evalContext = lookUpEvalContext(playout.gameState, evalContextLookup);
+      }
+    }
+    for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+      const Piece *piece = &PIECE_LIST[pieceIndex];
+      int batchSize = 0;
+      for (int i = 0; i < numPlayouts; i++) {
+        PlayoutState &playout = *playouts[i];
+        if (playout.isFinished || playout.pieceSequence[moveIndex] != pieceIndex || prefixLeaders[i] != i) {
+          continue;
+        }
+        batch[batchSize] = &playout;
+        batchSize++;
+        if (batchSize == MOVE_SEARCH_BATCH_SIZE) {
+          playBatchStep(batch, batchSize, moveIndex, playoutLength, originalAiMode, piece, trackPlayouts);
+          batchSize = 0;
+        }
       }
-      if (trackPlayouts) {
-        newPlayoutData.totalScore = totalReward + evalScore;
-        copyBoard(nextState.board, newPlayoutData.resultingBoard);
-        insertIntoList(newPlayoutData, playoutDataList);
+      if (batchSize > 0) {
+        playBatchStep(batch, batchSize, moveIndex, playoutLength, originalAiMode, piece, trackPlayouts);
       }
-      return totalReward + evalScore;
     }
 
-    // Otherwise, update the state to keep playing
-    int oldLines = gameState.lines;
-    gameState = advanceGameState(gameState, bestMove, evalContext);
-    
-    if (SHOULD_PLAY_PERFECT){
-      if ((gameState.lines - oldLines) % 4 != 0){
-        return 0; // 0% chance of continuing perfect
-      }
-    } else {
-      FastEvalWeights rewardWeights = evalContext->aiMode == DIG ? getWeights(STANDARD) : weights; // When the AI is digging, still deduct from the overall value of the sequence at standard amounts
-      totalReward += getLineClearFactor(gameState.lines - oldLines, rewardWeights, evalContext->shouldRewardLineClears);
-      if (PLAYOUT_LOGGING_ENABLED) {
-        printBoard(gameState.board);
-        printf("Best placement: %c %d, %d\n\n", bestMove.piece->id, bestMove.rotationIndex, bestMove.x - SPAWN_X);
+    for (int i = 0; i < numPlayouts; i++) {
+      PlayoutState &playout = *playouts[i];
+      if (!playout.isFinished && prefixLeaders[i] != i) {
+        const int *pieceSequence = playout.pieceSequence;
+        playout = *playouts[prefixLeaders[i]];
+        playout.pieceSequence = pieceSequence;
       }
     }
   }
-  return -1; // Doesn't reach here, always returns from i == 9 case
 }
 
+/**
+ * The playouts for one candidate, split up by their first piece so that each group can be played on its own thread
+ * (see playPlayoutGroup). Each group can still share its first move (see playPlayouts).
+ */
+struct PlayoutJob {
+  vector<PlayoutState> playouts;
+  vector<PlayoutState *> groups[7];
+  int playoutLength;
+  AiMode originalAiMode;
+  const EvalContextLookup *evalContextLookup;
+  bool trackPlayouts;
+};
+
+/**
+ * Special case: if the playout count is equal to the full count of possible sequences at the requested length, use the exahustive sequence list,
+ * as opposed to randomly generated ones.
+ */
+bool usesExhaustiveSequences(int playoutCount, int playoutLength) {
+  return (playoutCount == 7 && playoutLength == 1)
+    || (playoutCount == 49 && playoutLength == 2)
+    || (playoutCount == 343 && playoutLength == 3)
+    || (playoutCount == 2401 && playoutLength == 4);
+}
+
+/**
+ * Reorders the exhaustive sequences of a given length so that every 7 in a row (starting from a multiple of 7) have
+ * each piece once at every point in the sequence. In their normal order, the first 7 would all have the same second
+ * piece, so a slice of them would be biased towards that piece.
+ * Each piece is the one at the same point in the normal order, shifted by all the pieces before it.
+ */
+int getStratifiedSequenceIndex(int position, int playoutLength) {
+  int sequenceIndex = 0;
+  int placeValue = 1;
+  int shift = 0;
+  for (int i = 0; i < playoutLength; i++) {
+    shift += position % 7;
+    sequenceIndex += (shift % 7) * placeValue;
+    position /= 7;
+    placeValue *= 7;
+  }
+  return sequenceIndex;
+}
+
+/**
+ * Sets up the playouts for a candidate, using the sequences from firstPlayout to firstPlayout + numPlayouts - 1.
+ * The job mustn't be moved afterwards, since the groups point into it.
+ * @param stratifySequences - whether to take the exhaustive sequences in stratified order (see getStratifiedSequenceIndex)
+ */
+void preparePlayouts(GameState gameState, int firstPlayout, int numPlayouts, int playoutLength, bool useExhaustiveSequences, bool stratifySequences, EvalContextLookup const &evalContextLookup, int firstPieceIndex, bool trackPlayouts, OUT PlayoutJob &job){
+  // Index into the sequences based on the last known piece given by the in-game randomizer.
+  // The piece RNG is dependent on the previous piece, we will then have 1000 sequences with accurate RNG given the last known piece
+  int pieceOffset = 1000 + firstPieceIndex * NUM_CANONICAL_SEQUENCES_PER_PIECE;
 
-float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, OUT vector<PlayoutData> *playoutDataList){
+  // Note down the original AI mode to prevent the AI from putting itself in alternate modes to affect the valuations
+  job.originalAiMode = lookUpEvalContext(gameState, evalContextLookup)->aiMode;
+  job.playoutLength = playoutLength;
+  job.evalContextLookup = &evalContextLookup;
+  job.trackPlayouts = trackPlayouts;
+
+  vector<PlayoutState> &playouts = job.playouts;
+  playouts.resize(numPlayouts);
+  for (int i = 0; i < numPlayouts; i++) {
+    int sequenceIndex = stratifySequences && useExhaustiveSequences
+          ? getStratifiedSequenceIndex(firstPlayout + i, playoutLength)
+          : firstPlayout + i;
+    playouts[i].gameState = gameState;
+    playouts[i].pieceSequence = useExhaustiveSequences 
+          ? exhaustivePieceSequences + sequenceIndex * EXHAUSTIVE_SEQUENCE_LENGTH // Index into the exhaustive list of possible sequences;
+          : canonicalPieceSequences + (pieceOffset + sequenceIndex) * SEQUENCE_LENGTH; // Index into the mega array of randomly-generated piece sequences;
+    playouts[i].totalReward = 0;
+    playouts[i].isFinished = false;
+    playouts[i].score = -1; // Only kept if the playout has no moves at all
+    playouts[i].hasPlayoutData = false;
+    job.groups[playouts[i].pieceSequence[0]].push_back(&playouts[i]);
+  }
+}
+
+void playPlayoutGroup(PlayoutJob &job, int groupIndex) {
+  vector<PlayoutState *> &group = job.groups[groupIndex];
+  playPlayouts(group.data(), group.size(), job.playoutLength, job.originalAiMode, *job.evalContextLookup, job.trackPlayouts);
+}
+
+void playPlayoutGroupTask(void *taskData, int groupIndex) {
+  playPlayoutGroup(*(PlayoutJob *) taskData, groupIndex);
+}
+
+/** Adds up the scores of a candidate's playouts, in their original order. */
+float finishPlayouts(PlayoutJob &job, OUT vector<PlayoutData> *playoutDataList){
+  float playoutScore = 0;
+  for (PlayoutState &playout : job.playouts) {
+    if (playout.hasPlayoutData) {
+      insertIntoList(playout.playoutData, playoutDataList);
+    }
+    // printf("Did playout with score %f %d\n", playout.score, playoutDataList->size());
+    playoutScore += playout.score;
+  }
+
+  return playoutScore;
+}
+
+float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT vector<PlayoutData> *playoutDataList){
   // // Don't perform playouts if logging is enabled
   // if (LOGGING_ENABLED) {
   //   return 0;
   // }
 
-  // Index into the sequences based on the last known piece given by the in-game randomizer.
-  // The piece RNG is dependent on the previous piece, we will then have 1000 sequences with accurate RNG given the last known piece
-  int pieceOffset = 1000 + firstPieceIndex * 1000;
-  
-  // Special case: if the playout count is equal to the full count of possible sequences at the requested length, use the exahustive sequence list,
-  // as opposed to randomly generated ones.
-  bool useExhaustiveSequences = (playoutCount == 7 && playoutLength == 1)
-    || (playoutCount == 49 && playoutLength == 2)
-    || (playoutCount == 343 && playoutLength == 3)
-    || (playoutCount == 2401 && playoutLength == 4);
+  PlayoutJob job;
+  preparePlayouts(gameState, 0, playoutCount, playoutLength, usesExhaustiveSequences(playoutCount, playoutLength), /* stratifySequences= */ false, evalContextLookup, firstPieceIndex, TRACK_PLAYOUT_DETAILS && playoutDataList != NULL, job);
 
-  float playoutScore = 0;
-  for (int i = 0; i < playoutCount; i++) {
-    // Do one playout
-    const int *pieceSequence = useExhaustiveSequences 
-          ? exhaustivePieceSequences + i * EXHAUSTIVE_SEQUENCE_LENGTH // Index into the exhaustive list of possible sequences;
-          : canonicalPieceSequences + (pieceOffset + i) * SEQUENCE_LENGTH; // Index into the mega array of randomly-generated piece sequences;
-    float resultScore = playSequence(gameState, pieceRangeContextLookup, pieceSequence, playoutLength, playoutDataList);
-    // printf("Did playout with score %f %d\n", resultScore, playoutDataList->size());
-    playoutScore += resultScore;
+  if (getThreadCount() > 1) {
+    runInParallel(playPlayoutGroupTask, &job, 7);
+  } else {
+    // On one thread, play them all together so that the move searches batch across groups
+    vector<PlayoutState *> allPlayouts(playoutCount);
+    for (int i = 0; i < playoutCount; i++) {
+      allPlayouts[i] = &job.playouts[i];
+    }
+    playPlayouts(allPlayouts.data(), playoutCount, playoutLength, job.originalAiMode, evalContextLookup, job.trackPlayouts);
   }
 
+  float playoutScore = finishPlayouts(job, playoutDataList);
   if (PLAYOUT_RESULT_LOGGING_ENABLED) {
     printf("PlayoutScore %.1f\n", playoutScore / playoutCount);
   }
   return playoutCount == 0 ? 0 : (playoutScore / playoutCount);
 }
+
+void playPlayoutGroupOfJobsTask(void *taskData, int taskIndex) {
+  PlayoutJob *jobs = (PlayoutJob *) taskData;
+  playPlayoutGroup(jobs[taskIndex / 7], taskIndex % 7);
+}
+
+/** Plays out several jobs at once, handing out every group of every job as its own task so that the threads stay busy until the very end. */
+void playJobs(vector<PlayoutJob> &jobs) {
+  runInParallel(playPlayoutGroupOfJobsTask, jobs.data(), jobs.size() * 7);
+}
+
+void getPlayoutScores(GameState const resultingStates[], int numCandidates, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT vector<PlayoutData> playoutDataLists[], OUT float playoutScores[]){
+  if (getThreadCount() == 1) {
+    for (int i = 0; i < numCandidates; i++) {
+      playoutScores[i] = getPlayoutScore(resultingStates[i], playoutCount, playoutLength, evalContextLookup, firstPieceIndex, playoutDataLists == NULL ? NULL : &playoutDataLists[i]);
+    }
+    return;
+  }
+
+  vector<PlayoutJob> jobs(numCandidates);
+  for (int i = 0; i < numCandidates; i++) {
+    preparePlayouts(resultingStates[i], 0, playoutCount, playoutLength, usesExhaustiveSequences(playoutCount, playoutLength), /* stratifySequences= */ false, evalContextLookup, firstPieceIndex, TRACK_PLAYOUT_DETAILS && playoutDataLists != NULL, jobs[i]);
+  }
+  playJobs(jobs);
+  for (int i = 0; i < numCandidates; i++) {
+    float playoutScore = finishPlayouts(jobs[i], playoutDataLists == NULL ? NULL : &playoutDataLists[i]);
+    playoutScores[i] = playoutCount == 0 ? 0 : (playoutScore / playoutCount);
+  }
+}
+
+/** Sorts candidates by their estimated score, best first, keeping the original order for ties. */
+bool isBetterEstimate(pair<float, int> const &a, pair<float, int> const &b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+void getPlayoutScoresAdaptive(GameState const resultingStates[], float const immediateRewards[], int numCandidates, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT float playoutScores[], OUT int playoutCounts[]){
+  bool useExhaustiveSequences = usesExhaustiveSequences(playoutCount, playoutLength);
+  int maxPlayouts = useExhaustiveSequences ? playoutCount : NUM_CANONICAL_SEQUENCES_PER_PIECE;
+  int budgetLeft = numCandidates * playoutCount;
+  int numRounds = 1;
+  while ((1 << numRounds) < numCandidates) {
+    numRounds++;
+  }
+
+  vector<float> totalScores(numCandidates, 0);
+  vector<int> contenders;
+  for (int i = 0; i < numCandidates; i++) {
+    playoutCounts[i] = 0;
+    contenders.push_back(i);
+  }
+  for (int round = 0; round < numRounds && budgetLeft > 0; round++) {
+    // Spread what's left of the budget evenly over the remaining rounds. Keep it to whole groups of 7, so that each
+    // first piece gets as many playouts as the others (at least for the exhaustive sequences).
+    int playoutsEach = budgetLeft / (numRounds - round) / (int) contenders.size();
+    if (playoutsEach >= 7) {
+      playoutsEach -= playoutsEach % 7;
+    }
+    playoutsEach = max(1, playoutsEach);
+
+    vector<PlayoutJob> jobs(contenders.size());
+    for (int j = 0; j < (int) contenders.size(); j++) {
+      int c = contenders[j];
+      int numPlayouts = min(playoutsEach, min(maxPlayouts - playoutCounts[c], budgetLeft));
+      budgetLeft -= numPlayouts;
+      preparePlayouts(resultingStates[c], playoutCounts[c], numPlayouts, playoutLength, useExhaustiveSequences, /* stratifySequences= */ true, evalContextLookup, firstPieceIndex, /* trackPlayouts= */ false, jobs[j]);
+    }
+    playJobs(jobs);
+
+    // Keep the better half of the contenders, by the mean of their playouts so far
+    vector<pair<float, int>> estimates;
+    for (int j = 0; j < (int) contenders.size(); j++) {
+      int c = contenders[j];
+      totalScores[c] += finishPlayouts(jobs[j], /* playoutDataList= */ NULL);
+      playoutCounts[c] += jobs[j].playouts.size();
+      estimates.push_back({immediateRewards[c] + (playoutCounts[c] == 0 ? 0 : totalScores[c] / playoutCounts[c]), c});
+    }
+    sort(estimates.begin(), estimates.end(), isBetterEstimate);
+    contenders.clear();
+    for (int j = 0; j < ((int) estimates.size() + 1) / 2; j++) {
+      // Ones that have used up all their sequences can't be played out any further
+      if (playoutCounts[estimates[j].second] < maxPlayouts) {
+        contenders.push_back(estimates[j].second);
+      }
+    }
+    if (contenders.empty()) {
+      break;
+    }
+  }
+
+  for (int i = 0; i < numCandidates; i++) {
+    playoutScores[i] = playoutCounts[i] == 0 ? 0 : totalScores[i] / playoutCounts[i];
+  }
+}
+
+/**
+ * An upper bound on the score of any one playout from a state: the most each move can earn in line clears, plus the
+ * most the final eval can be worth. Taken over every context the playout could switch into along the way.
+ */
+float getPlayoutUpperBound(GameState const &gameState, int playoutLength, EvalContextLookup const &evalContextLookup) {
+  vector<const EvalContext *> contexts;
+  getReachableEvalContexts(gameState, playoutLength, evalContextLookup, contexts);
+  float maxReward = 0;
+  float maxEvalScore = FLOAT_MIN;
+  for (const EvalContext *evalContext : contexts) {
+    FastEvalWeights rewardWeights = evalContext->aiMode == DIG ? getWeights(STANDARD) : evalContext->weights; // Same as in playSequenceStep
+    for (int numLines = 1; numLines <= 4; numLines++) {
+      maxReward = max(maxReward, getLineClearFactor(numLines, rewardWeights, evalContext->shouldRewardLineClears));
+    }
+    maxEvalScore = max(maxEvalScore, getEvalUpperBound(evalContext));
+  }
+  // In perfect play, only the final eval counts
+  return SHOULD_PLAY_PERFECT ? maxEvalScore : (playoutLength - 1) * maxReward + maxEvalScore;
+}
+
+#define PRUNING_TOLERANCE 0.1 // Covers the rounding in the bounds, which are added up in a different order than the exact scores
+
+/** One round of the pruned playouts: a single group of each candidate that's still in the running. */
+struct PlayoutRound {
+  PlayoutJob *jobs;
+  const int *candidates;
+  int groupIndex;
+};
+
+void playPlayoutRoundTask(void *taskData, int taskIndex) {
+  PlayoutRound *round = (PlayoutRound *) taskData;
+  playPlayoutGroup(round->jobs[round->candidates[taskIndex]], round->groupIndex);
+}
+
+void getPlayoutScoresPruned(GameState const resultingStates[], float const immediateRewards[], int numCandidates, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT float playoutScores[], OUT int playoutCounts[]){
+  if (numCandidates == 0) {
+    return;
+  }
+  vector<PlayoutJob> jobs(numCandidates);
+  for (int i = 0; i < numCandidates; i++) {
+    preparePlayouts(resultingStates[i], 0, playoutCount, playoutLength, usesExhaustiveSequences(playoutCount, playoutLength), /* stratifySequences= */ false, evalContextLookup, firstPieceIndex, /* trackPlayouts= */ false, jobs[i]);
+    playoutCounts[i] = 0;
+  }
+
+  // The first candidate is the most promising before playouts, so its exact score is the bar that the others have to clear
+  runInParallel(playPlayoutGroupTask, &jobs[0], 7);
+  playoutScores[0] = playoutCount == 0 ? 0 : finishPlayouts(jobs[0], /* playoutDataList= */ NULL) / playoutCount;
+  playoutCounts[0] = playoutCount;
+  float scoreToBeat = immediateRewards[0] + playoutScores[0];
+
+  // Play the others one group (i.e. first piece) at a time, and drop the ones that couldn't catch up even if every
+  // playout left scored the maximum
+  vector<float> partialScores(numCandidates, 0);
+  vector<float> maxPlayoutScores(numCandidates);
+  vector<int> contenders;
+  for (int i = 1; i < numCandidates; i++) {
+    maxPlayoutScores[i] = getPlayoutUpperBound(resultingStates[i], playoutLength, evalContextLookup);
+    contenders.push_back(i);
+  }
+  for (int groupIndex = 0; groupIndex < 7 && !contenders.empty(); groupIndex++) {
+    PlayoutRound round = {jobs.data(), contenders.data(), groupIndex};
+    runInParallel(playPlayoutRoundTask, &round, contenders.size());
+
+    vector<int> stillContending;
+    for (int c : contenders) {
+      for (PlayoutState *playout : jobs[c].groups[groupIndex]) {
+        partialScores[c] += playout->score;
+      }
+      playoutCounts[c] += jobs[c].groups[groupIndex].size();
+      float upperBound = immediateRewards[c] + (partialScores[c] + (playoutCount - playoutCounts[c]) * maxPlayoutScores[c]) / playoutCount;
+      if (playoutCounts[c] < playoutCount && upperBound < scoreToBeat - PRUNING_TOLERANCE) {
+        maybePrint("Pruned candidate %d after %d playouts (at most %f vs %f)\n", c, playoutCounts[c], upperBound, scoreToBeat);
+        playoutScores[c] = partialScores[c] / playoutCounts[c];
+      } else {
+        stillContending.push_back(c);
+      }
+    }
+    contenders = stillContending;
+  }
+
+  // Add up the ones that were played to the end in the same order as getPlayoutScores, so the scores match exactly
+  for (int c : contenders) {
+    playoutScores[c] = playoutCount == 0 ? 0 : finishPlayouts(jobs[c], /* playoutDataList= */ NULL) / playoutCount;
+  }
+}
@@ -8,8 +8,34 @@
 
 LockPlacement pickLockPlacement(GameState gameState,
                            const EvalContext *evalContext,
-                           OUT std::vector<LockPlacement> &lockPlacements);
+                           OUT LockPlacementList &lockPlacements);
 
-float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int pieceOffsetIndex, OUT vector<PlayoutData> *playoutDataList);
+float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int pieceOffsetIndex, OUT vector<PlayoutData> *playoutDataList);
+
+/**
+ * Same as getPlayoutScore for several candidates, but spreads all of their playouts across the thread pool at once.
+ * @param playoutDataLists - one list per candidate, or NULL if the playout data isn't needed
+ */
+void getPlayoutScores(GameState const resultingStates[], int numCandidates, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT vector<PlayoutData> playoutDataLists[], OUT float playoutScores[]);
+
+/**
+ * Splits the playouts of several candidates by successive halving: every candidate gets a first share, then after each
+ * round only the better half (by immediate reward + mean playout score so far) get played out further. Uses at most the
+ * number of playouts of giving each candidate playoutCount, but spends most of them on the leading candidates.
+ * No candidate gets more playouts than there are sequences, so with the exhaustive sequences the leaders stop at
+ * playoutCount and the rest of the budget goes unused. Those are played a stratified slice at a time, so that each
+ * round covers every piece equally (see getStratifiedSequenceIndex).
+ * @param playoutCounts - how many playouts each candidate got. The scores of ones dropped early are only the mean of
+ * the playouts they got, so they shouldn't be compared with the others.
+ */
+void getPlayoutScoresAdaptive(GameState const resultingStates[], float const immediateRewards[], int numCandidates, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT float playoutScores[], OUT int playoutCounts[]);
+
+/**
+ * Gives the same best candidate as getPlayoutScores, but stops playing out candidates once they can't beat the first
+ * one, using an upper bound on the score of each playout left. Only the candidates played to the end get their exact
+ * score; the others get the mean of the playouts they did play, and fewer playoutCounts.
+ * @param immediateRewards - the rewards that get added to each candidate's playout score to compare them
+ */
+void getPlayoutScoresPruned(GameState const resultingStates[], float const immediateRewards[], int numCandidates, int playoutCount, int playoutLength, EvalContextLookup const &evalContextLookup, int firstPieceIndex, OUT float playoutScores[], OUT int playoutCounts[]);
 
 #endif
@@ -0,0 +1,103 @@
+#include "surface_ranks.hpp"
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Ranks file format (written by generateBase7RanksFile in file_converter.ts):
+ *   8 bytes   the magic string "SRRANKS7"
+ *   4 bytes   the number of ranks, little-endian (must equal NUM_SURFACE_RANKS)
+ *   4 bytes   reserved, always 0
+ *   N bytes   one rank per surface, in order of the base-7 surface encoding
+ */
+#define SURFACE_RANKS_MAGIC "SRRANKS7"
+#define SURFACE_RANKS_HEADER_SIZE 16
+#define SURFACE_RANKS_FILE_SIZE (SURFACE_RANKS_HEADER_SIZE + NUM_SURFACE_RANKS)
+
+const unsigned char *surfaceRanks = NULL;
+unsigned int surfaceRanksGeneration = 0;
+
+unsigned int readLittleEndian32(const unsigned char *bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int) bytes[3] << 24);
+}
+
+/** @returns an error message, or the empty string if the file has a valid header */
+std::string checkSurfaceRanksHeader(const unsigned char *fileBytes) {
+  if (memcmp(fileBytes, SURFACE_RANKS_MAGIC, 8) != 0) {
+    return "Not a surface ranks file";
+  }
+  if (readLittleEndian32(fileBytes + 8) != NUM_SURFACE_RANKS) {
+    return "Surface ranks file has the wrong number of ranks";
+  }
+  return "";
+}
+
+#ifdef _WIN32
+
+// No mmap here, so each process reads its own copy
+std::vector<unsigned char> surfaceRanksFileBytes;
+
+std::string loadSurfaceRanks(char const *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return std::string("Couldn't open surface ranks file: ") + path;
+  }
+  std::vector<unsigned char> fileBytes(SURFACE_RANKS_FILE_SIZE + 1);
+  size_t numRead = fread(fileBytes.data(), 1, fileBytes.size(), file);
+  fclose(file);
+  if (numRead != SURFACE_RANKS_FILE_SIZE) {
+    return std::string("Surface ranks file is the wrong size: ") + path;
+  }
+  std::string error = checkSurfaceRanksHeader(fileBytes.data());
+  if (!error.empty()) {
+    return error + ": " + path;
+  }
+  surfaceRanksFileBytes.swap(fileBytes);
+  surfaceRanks = surfaceRanksFileBytes.data() + SURFACE_RANKS_HEADER_SIZE;
+  surfaceRanksGeneration++;
+  return "";
+}
+
+#else
+
+const unsigned char *surfaceRanksMapping = NULL;
+
+std::string loadSurfaceRanks(char const *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return std::string("Couldn't open surface ranks file: ") + path;
+  }
+  struct stat fileInfo;
+  if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size != SURFACE_RANKS_FILE_SIZE) {
+    close(fd);
+    return std::string("Surface ranks file is the wrong size: ") + path;
+  }
+  void *mapping = mmap(NULL, SURFACE_RANKS_FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // The mapping stays valid after the file is closed
+  if (mapping == MAP_FAILED) {
+    return std::string("Couldn't map surface ranks file: ") + path;
+  }
+  const unsigned char *fileBytes = (const unsigned char *) mapping;
+  std::string error = checkSurfaceRanksHeader(fileBytes);
+  if (!error.empty()) {
+    munmap(mapping, SURFACE_RANKS_FILE_SIZE);
+    return error + ": " + path;
+  }
+
+  if (surfaceRanksMapping != NULL) {
+    munmap((void *) surfaceRanksMapping, SURFACE_RANKS_FILE_SIZE);
+  }
+  surfaceRanksMapping = fileBytes;
+  surfaceRanks = fileBytes + SURFACE_RANKS_HEADER_SIZE;
+  surfaceRanksGeneration++;
+  return "";
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef SURFACE_RANKS
+#define SURFACE_RANKS
+
+#include <string>
+
+#define NUM_SURFACE_RANKS 5764801 // = 7^8, one for each value of the base-7 surface encoding
+
+/**
+ * The rank of each surface, scaled to fit in a byte, or NULL if no ranks file has been loaded.
+ * Points into a read-only mapping of the ranks file, so every process that loads the same file shares its pages.
+ */
+extern const unsigned char *surfaceRanks;
+
+/** Goes up every time a ranks file is loaded, so that evals cached with the previous ranks aren't reused (see getEvalCacheKey). */
+extern unsigned int surfaceRanksGeneration;
+
+/**
+ * Loads a ranks file (see surface_ranks.cpp for the format) and starts using it for all evals, replacing any
+ * previously loaded ranks. Since the old ranks are released, this shouldn't be called while a search is running.
+ * @returns an error message (in which case the previous ranks are kept), or the empty string on success
+ */
+std::string loadSurfaceRanks(char const *path);
+
+#endif
@@ -0,0 +1,135 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Wasm builds only get threads when compiled with pthreads support
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define THREADS_SUPPORTED 0
+#else
+#define THREADS_SUPPORTED 1
+#endif
+
+#define MAX_THREAD_COUNT 256
+
+/**
+ * A fixed set of worker threads that sleep until a job is started. The thread that starts a job works on it too, so
+ * a pool for N threads has N - 1 workers.
+ */
+struct ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex jobMutex; // Held for the whole of a job, so that only one runs at a time
+  std::mutex mutex; // Guards the fields below
+  std::condition_variable jobStarted;
+  std::condition_variable jobFinished;
+  int jobId = 0; // Incremented for each job, so workers can tell a new job from a spurious wakeup
+  int numWorkersBusy = 0;
+  bool isShuttingDown = false;
+
+  // The current job
+  ParallelTask task = NULL;
+  void *taskData = NULL;
+  int numTasks = 0;
+  std::atomic<int> nextTaskIndex{0};
+
+  ~ThreadPool();
+};
+
+ThreadPool threadPool;
+
+// Whether the current thread is already running tasks for the pool
+thread_local bool isInsideParallelTask = false;
+
+void runTasks(ParallelTask task, void *taskData, int numTasks, std::atomic<int> &nextTaskIndex) {
+  for (int i = nextTaskIndex++; i < numTasks; i = nextTaskIndex++) {
+    task(taskData, i);
+  }
+}
+
+/** @param lastJobId the id of the last job started before the worker was, since the thread may only start running later */
+void runWorker(ThreadPool *pool, int lastJobId) {
+  isInsideParallelTask = true;
+  std::unique_lock<std::mutex> lock(pool->mutex);
+  while (true) {
+    while (!pool->isShuttingDown && pool->jobId == lastJobId) {
+      pool->jobStarted.wait(lock);
+    }
+    if (pool->isShuttingDown) {
+      return;
+    }
+    lastJobId = pool->jobId;
+    lock.unlock();
+    runTasks(pool->task, pool->taskData, pool->numTasks, pool->nextTaskIndex);
+    lock.lock();
+    pool->numWorkersBusy--;
+    if (pool->numWorkersBusy == 0) {
+      pool->jobFinished.notify_one();
+    }
+  }
+}
+
+void stopWorkers(ThreadPool &pool) {
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.isShuttingDown = true;
+  }
+  pool.jobStarted.notify_all();
+  for (std::thread &worker : pool.workers) {
+    worker.join();
+  }
+  pool.workers.clear();
+  pool.isShuttingDown = false;
+}
+
+ThreadPool::~ThreadPool() {
+  stopWorkers(*this);
+}
+
+void setThreadCount(int numThreads) {
+  if (!THREADS_SUPPORTED) {
+    return;
+  }
+  numThreads = std::max(1, std::min(MAX_THREAD_COUNT, numThreads));
+  std::lock_guard<std::mutex> jobLock(threadPool.jobMutex);
+  stopWorkers(threadPool);
+  for (int i = 0; i < numThreads - 1; i++) {
+    threadPool.workers.push_back(std::thread(runWorker, &threadPool, threadPool.jobId));
+  }
+}
+
+int getThreadCount() {
+  return (int) threadPool.workers.size() + 1;
+}
+
+void runInParallel(ParallelTask task, void *taskData, int numTasks) {
+  if (isInsideParallelTask || threadPool.workers.empty() || numTasks <= 1) {
+    for (int i = 0; i < numTasks; i++) {
+      task(taskData, i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> jobLock(threadPool.jobMutex);
+  {
+    std::lock_guard<std::mutex> lock(threadPool.mutex);
+    threadPool.task = task;
+    threadPool.taskData = taskData;
+    threadPool.numTasks = numTasks;
+    threadPool.nextTaskIndex = 0;
+    threadPool.numWorkersBusy = threadPool.workers.size();
+    threadPool.jobId++;
+  }
+  threadPool.jobStarted.notify_all();
+
+  isInsideParallelTask = true;
+  runTasks(task, taskData, numTasks, threadPool.nextTaskIndex);
+  isInsideParallelTask = false;
+
+  std::unique_lock<std::mutex> lock(threadPool.mutex);
+  while (threadPool.numWorkersBusy > 0) {
+    threadPool.jobFinished.wait(lock);
+  }
+}
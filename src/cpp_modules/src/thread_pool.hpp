@@ -0,0 +1,23 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+/** One unit of parallel work, run once for each task index (see runInParallel). */
+typedef void (*ParallelTask)(void *taskData, int taskIndex);
+
+/**
+ * Sets how many threads a search can use, counting the thread that made the request. 1 (the default) runs everything
+ * on the calling thread. Shouldn't be called while a search is running.
+ */
+void setThreadCount(int numThreads);
+
+int getThreadCount();
+
+/**
+ * Runs the task for each index from 0 to numTasks - 1 across the pool's threads, and returns once they're all done.
+ * Each thread takes the next index as soon as it finishes one, so uneven tasks still balance out. Tasks must only write
+ * to the state of their own index.
+ * When called from inside a task, the tasks are run serially on that thread instead.
+ */
+void runInParallel(ParallelTask task, void *taskData, int numTasks);
+
+#endif
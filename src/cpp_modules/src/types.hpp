@@ -18,7 +18,21 @@
 
 #define NO_TUCK_NOTATION '.'
 
+#include <assert.h>
+#include <stdio.h>
+#include <string>
 #include <vector>
+#include "config.hpp"
+
+// The most midair placements one move search can register. Per goal rotation, each exploration direction registers at most
+// one placement per column, and the near-spawn pass at most 3 (see move_search.cpp).
+#define MAX_MIDAIR_PLACEMENTS 96
+// The most lock placements one move search can find. Tucks are deduplicated by lock position, so there are at most
+// 4 rotations * 10 columns * 22 rows of them, on top of the midair placements. The flood fill finds each lock position
+// once, so it stays within the same 4 * 10 * 22.
+#define MAX_LOCK_PLACEMENTS 1024
+// The most boards that one batched move search checks at once (see moveSearchBatch). Also the number of SIMD lanes it's written for.
+#define MOVE_SEARCH_BATCH_SIZE 8
 
 enum RequestType {
   GET_LOCK_VALUE_LOOKUP, // Gets a map of all the values for all possible places where the current piece could lock.
@@ -74,6 +88,26 @@ struct SimState {
   const Piece *piece;
 };
 
+enum TrajectoryCellType {
+  INPUT_CHECK, // A shift or rotation. If it collides, the exploration stops.
+  GRAVITY_CHECK, // A gravity drop. If it collides, the piece locks (and may still register a placement).
+  REGISTER_PLACEMENT // The piece reached the goal rotation, and its state going into the next frame is a legal placement.
+};
+
+/**
+ * One step of a precomputed move search trajectory.
+ * Replaying a trajectory against a board is equivalent to simulating the frames from spawn,
+ * since the piece follows the same path up until the first collision.
+ */
+struct TrajectoryCell {
+  int x;
+  int y;
+  int rotationIndex;
+  int frameIndex;
+  TrajectoryCellType type;
+  bool foundPlacementThisFrame; // Only used for gravity checks: whether the piece locking should still register a placement
+};
+
 /** Minimal representation of an entire placement, such that the input sequence is deterministic from the data here. */
 struct LockPlacement {
   int x;
@@ -88,6 +122,34 @@ const LockPlacement NO_PLACEMENT = {
   NONE, NONE, NONE, NONE, 'x', NULL
 };
 
+/**
+ * A list with a fixed capacity, stored inline (i.e. on the stack when used as a local variable).
+ * Used instead of std::vector in the move search, which runs too often to afford heap allocations. The capacities are
+ * the most items the move search can produce (see MAX_LOCK_PLACEMENTS), so going over one is a bug in the search.
+ */
+template <typename T, int CAPACITY>
+struct FixedList {
+  T items[CAPACITY];
+  int count = 0;
+
+  void push_back(T const &item) {
+    assert(count < CAPACITY);
+    items[count++] = item;
+  }
+  void clear() { count = 0; }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+  T &operator[](int i) { return items[i]; }
+  T const &operator[](int i) const { return items[i]; }
+  T *begin() { return items; }
+  T *end() { return items + count; }
+  T const *begin() const { return items; }
+  T const *end() const { return items + count; }
+};
+
+typedef FixedList<SimState, MAX_MIDAIR_PLACEMENTS> SimStateList;
+typedef FixedList<LockPlacement, MAX_LOCK_PLACEMENTS> LockPlacementList;
+
 /** Minimal representation of a lock location. */
 struct LockLocation {
   int x;
@@ -127,13 +189,39 @@ struct FastEvalWeights {
   float unableToBurnCoef;
 };
 
+#define MAX_INPUT_TIMELINE_LENGTH 64
+
+/**
+ * An input frame timeline (e.g. "X...", meaning an input every 4th frame), compiled once per request
+ * so that per-frame queries don't need to scan the string.
+ */
+struct InputTimeline {
+  int period; // The length of the repeating pattern
+  int inputsPerPeriod;
+  unsigned long long inputFrameMask; // Bit N is set if frame N of the pattern is an input frame
+  unsigned char inputsBeforeFrame[MAX_INPUT_TIMELINE_LENGTH + 1]; // How many input frames occur in the pattern before frame N
+};
+
+enum MoveSearchEngine {
+  FRAME_SIMULATION, // Simulates shifting towards each side, then looks for tucks around the overhang cells (see move_search.cpp)
+  FLOOD_FILL // Expands the set of reachable positions frame by frame, incl. tucks and spins (see flood_fill_search.cpp)
+};
+
+/** How the playouts of a move decision are split between its candidates. */
+enum PlayoutBudget {
+  FIXED_PLAYOUT_BUDGET, // Every candidate gets the requested playout count
+  SUCCESSIVE_HALVING, // The same total, but spent mostly on the leading candidates (see getPlayoutScoresAdaptive)
+  BOUND_PRUNING // Picks the same move as the fixed budget, but stops on candidates that can't win (see getPlayoutScoresPruned). Falls back to the fixed budget for the lock value lookup, which needs every score.
+};
+
 /**
  * Precomputed meta-information related to tapping speed and piece reachability.
  * Considered "global" because the tapping speed does not change within the lifetime of one query to the C++ module
  * (whereas the eval context can change based on the AiMode).
  */
 struct PieceRangeContext {
-  char const *inputFrameTimeline;
+  InputTimeline inputTimeline;
+  MoveSearchEngine moveSearchEngine;
   int yValueOfEachShift[7];
   int max4TapHeight;
   int max5TapHeight;
@@ -155,6 +243,35 @@ struct EvalContext {
   float scareHeight;
   int shouldRewardLineClears;
   int wellColumn; // Equals -1 if lining out
+  unsigned long long evalCacheKey; // A hash of the fields above that the eval reads (see getEvalCacheKey)
+};
+
+#define NUM_AI_MODES 5
+#define NUM_PIECE_RANGE_CONTEXTS 4 // Double killscreen, then one per gravity value
+#define DOUBLE_KILLSCREEN_CUTOFF_LINES 320
+#define DOUBLE_KILLSCREEN_INTERPOLATION_LINES 10 // How many lines it takes to shift to the double killscreen scare height
+#define NUM_SCARE_HEIGHT_BANDS ((DOUBLE_KILLSCREEN_ENABLED ? DOUBLE_KILLSCREEN_INTERPOLATION_LINES + 1 : 1) * 2)
+
+/**
+ * Every eval context that can come up within one request, indexed by mode, piece range context, and scare height band
+ * (see getScareHeightBand). Built once per request so that playouts can switch contexts without rebuilding them.
+ */
+struct EvalContextLookup {
+  const PieceRangeContext *pieceRangeContextLookup;
+  EvalContext contexts[NUM_AI_MODES][NUM_PIECE_RANGE_CONTEXTS][NUM_SCARE_HEIGHT_BANDS];
+};
+
+/**
+ * The eval inputs that depend only on a board's surface, kept per column so that they can be updated for just the
+ * columns that a placement changes (see fastEvalIncremental).
+ */
+struct SurfaceFeatures {
+  int rankDigits[8]; // The diff between each column and the next, as digits of the base-7 surface encoding
+  int rankExcessGaps[8]; // The part of each diff that's too big for the encoding
+  int rankIndex;
+  int excessGap;
+  int leftHeightAboveAccessible;
+  int rightHeightAboveAccessible;
 };
 
 struct Possibility {
@@ -3,6 +3,8 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <list>
 #include <random>
 #include "./config.hpp"
 
@@ -32,6 +34,27 @@
 
 #define MOD_4(x) ((x) & 3)
 
+// Hints that an address is about to be read, so the load can start early. Does nothing on compilers without the builtin.
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+/** The index of the lowest set bit, which must exist. Falls back to a loop on compilers without the builtin. */
+int getLowestBitIndex(unsigned int bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(bits);
+#else
+  int index = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    index++;
+  }
+  return index;
+#endif
+}
+
 /* ---------- LOGGING ----------- */
 
 void maybePrint(const char *format, ...) {
@@ -145,13 +168,39 @@ void getSurfaceArray(unsigned int board[20], int outSurface[10]) {
   for (int col = 0; col < 10; col++) {
     int colMask = 1 << (9 - col);
     int row = 0;
-    while (!(board[row] & colMask) && row < 20) {
+    while (row < 20 && !(board[row] & colMask)) {
       row++;
     }
     outSurface[col] = 20 - row;
   }
 }
 
+/**
+ * Makes the random game states that the tests run on, the same ones each time for a given seed. The stack height and
+ * how full its rows are vary from state to state, so there are both nearly solid stacks and ones full of holes and
+ * overhangs. The surfaces, levels (18 up to killscreen) and lines are filled in, but not the holes.
+ */
+void makeRandomGameStates(int numStates, unsigned int seed, int minFillPercent, OUT std::vector<GameState> &gameStates) {
+  std::mt19937 generator(seed);
+  gameStates.clear();
+  for (int i = 0; i < numStates; i++) {
+    GameState gameState = {{}, {}, 0, 0, 0, 0};
+    int stackHeight = generator() % 21;
+    int fillPercent = minFillPercent + generator() % (100 - minFillPercent);
+    for (int r = 20 - stackHeight; r < 20; r++) {
+      for (int c = 0; c < 10; c++) {
+        if ((int) (generator() % 100) < fillPercent) {
+          gameState.board[r] |= CELL_BIT(c);
+        }
+      }
+    }
+    getSurfaceArray(gameState.board, gameState.surfaceArray);
+    gameState.level = 18 + generator() % 12;
+    gameState.lines = generator() % 300;
+    gameStates.push_back(gameState);
+  }
+}
+
 /* ----------- MISC GAMEPLAY HELPERS ----------- */
 
 int getLevelAfterLineClears(int level, int lines, int numLinesCleared) {
@@ -187,33 +236,46 @@ bool isGravityDoubled(int level){
 }
 
 /**
- * Given a string such as X.... that represents a loop of which frames are allowed for inputs,
- * determines if a given frame index is an input frame
+ * Compiles a string such as X.... that represents a loop of which frames are allowed for inputs.
+ * Callers are expected to have validated the string (see isValidInputTimeline).
  */
-int shouldPerformInputsThisFrame(int frameIndex, char const *inputFrameTimeline) {
+InputTimeline compileInputTimeline(char const *inputFrameTimeline) {
+  InputTimeline timeline = {};
+  timeline.period = std::min((int) strlen(inputFrameTimeline), MAX_INPUT_TIMELINE_LENGTH);
+  for (int i = 0; i < timeline.period; i++) {
+    timeline.inputsBeforeFrame[i] = timeline.inputsPerPeriod;
+    if (inputFrameTimeline[i] == 'X') {
+      timeline.inputFrameMask |= 1ULL << i;
+      timeline.inputsPerPeriod++;
+    }
+  }
+  timeline.inputsBeforeFrame[timeline.period] = timeline.inputsPerPeriod;
+  return timeline;
+}
+
+/** Checks that a timeline string is non-empty, fits in an InputTimeline, and has at least one input frame. */
+bool isValidInputTimeline(char const *inputFrameTimeline) {
   int len = (int) strlen(inputFrameTimeline);
-  int index = frameIndex % len;
-  return inputFrameTimeline[index] == 'X';
+  return len > 0 && len <= MAX_INPUT_TIMELINE_LENGTH && strchr(inputFrameTimeline, 'X') != NULL;
+}
+
+/** Determines if a given frame index is an input frame */
+int shouldPerformInputsThisFrame(int frameIndex, InputTimeline const &inputTimeline) {
+  return (inputTimeline.inputFrameMask >> (frameIndex % inputTimeline.period)) & 1;
 }
 
-SimState predictStateAtAdjustmentTime(LockPlacement placement, char const *inputFrameTimeline, int gravity, bool gravityDoubled, int reactionTimeFrames){
+/** Counts the input frames strictly before a given frame index */
+int countInputsBeforeFrame(int frameIndex, InputTimeline const &inputTimeline) {
+  return (frameIndex / inputTimeline.period) * inputTimeline.inputsPerPeriod
+         + inputTimeline.inputsBeforeFrame[frameIndex % inputTimeline.period];
+}
+
+SimState predictStateAtAdjustmentTime(LockPlacement placement, InputTimeline const &inputTimeline, int gravity, bool gravityDoubled, int reactionTimeFrames){
   // Figure out how many frames of input will have elapsed
-  // At the same time, calculate the Y value at adjustment time
-  int inputsPerformed = 0;
-  int adjTimeY = placement.piece->initialY;
-  for (int frame = 0; frame < reactionTimeFrames; frame++) {
-    if (shouldPerformInputsThisFrame(frame, inputFrameTimeline)) {
-      inputsPerformed++;
-    }
-    // On double killscreen, increment gravity twice every frame
-    if (gravityDoubled){
-      adjTimeY += 2;
-    }
-    // Returns true every Nth frame, where N = gravity 
-    else if (frame % gravity == gravity - 1) {
-      adjTimeY++;
-    }
-  }
+  int inputsPerformed = countInputsBeforeFrame(reactionTimeFrames, inputTimeline);
+  // Calculate the Y value at adjustment time. On double killscreen, gravity increments twice every frame.
+  // Otherwise it increments every Nth frame, where N = gravity.
+  int adjTimeY = placement.piece->initialY + (gravityDoubled ? 2 * reactionTimeFrames : reactionTimeFrames / gravity);
   if (adjTimeY > placement.y) {
     return {};
   }
@@ -29,6 +29,20 @@ std::string wasmRateMove(std::string inputStr) {
     return mainProcess(cInputStr, RATE_MOVE);
 }
 
+/** @returns an error message, or the empty string on success */
+std::string wasmLoadSurfaceRanks(std::string path) {
+    return loadSurfaceRanks(path.c_str());
+}
+
+/** Has no effect unless the module was compiled with pthreads support */
+void wasmSetThreadCount(int numThreads) {
+    setThreadCount(numThreads);
+}
+
+std::string wasmGetEngineStats() {
+    return getEngineStats();
+}
+
 
 EMSCRIPTEN_BINDINGS(my_module) {
     emscripten::function("getLockValueLookup", &wasmGetLockValueLookup);
@@ -36,5 +50,8 @@ EMSCRIPTEN_BINDINGS(my_module) {
     emscripten::function("getTopMoves", &wasmGetTopMoves);
     emscripten::function("getTopMovesHybrid", &wasmGetTopMovesHybrid);
     emscripten::function("rateMove", &wasmRateMove);
+    emscripten::function("loadSurfaceRanks", &wasmLoadSurfaceRanks);
+    emscripten::function("setThreadCount", &wasmSetThreadCount);
+    emscripten::function("getEngineStats", &wasmGetEngineStats);
 }
 
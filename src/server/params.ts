@@ -26,6 +26,15 @@ export const CPP_LIVEGAME_PLAYOUT_COUNT = 49;
 export const CPP_LIVEGAME_PLAYOUT_LENGTH = 2;
 export const CPP_LIVEGAME_PRUNING_BREADTH = 10;
 
+/**
+ * How many threads the C++ module spreads its playouts over, read from an environment variable (e.g. set in .env).
+ * Defaults to 1, which runs everything on the calling thread.
+ */
+export function getCppThreadCount(envVarName: string): number {
+  const threadCount = parseInt(process.env[envVarName]);
+  return threadCount > 0 ? threadCount : 1;
+}
+
 // Rarely changed
 export const IS_PAL = false;
 export const WELL_COLUMN = 9; // 0-indexed
@@ -2,7 +2,7 @@ import { engineLookup, engineLookupTopMoves } from "./engine_lookup";
 import { rateSurface } from "./evaluator";
 import { getSearchStateAfter } from "./main";
 import { getPossibleMoves } from "./move_search";
-import { SHOULD_LOG } from "./params";
+import { SHOULD_LOG, getCppThreadCount } from "./params";
 import { PreComputeManager } from "./precompute";
 import {
   boardEquals,
@@ -35,6 +35,8 @@ export class RequestHandler {
   computationsFinished: number;
 
   constructor(precomputeManager) {
+    // Only applies to the C++ requests handled on this process, since the precompute workers each load their own copy
+    cModule.setThreadCount(getCppThreadCount("CPP_THREAD_COUNT"));
     this.preComputeManager = precomputeManager;
     this.asyncCallInProgress = false;
     this.asyncResult = null;
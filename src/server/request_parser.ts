@@ -27,6 +27,8 @@ export function parseUrlArguments(
     playoutCount: 49,
     playoutLength: 2,
     pruningBreadth: 20,
+    moveSearchEngine: 0,
+    playoutBudget: 0,
     existingXOffset: 0,
     existingYOffset: 0,
     existingRotation: 0,
@@ -188,6 +190,44 @@ export function parseUrlArguments(
         result.pruningBreadth = breadth;
         break;
 
+      case "moveSearchEngine":
+        if (!requestType.includes("cpp")) {
+          throw new Error(
+            "Parameter 'moveSearchEngine' does not apply to JS queries."
+          );
+        }
+        if (value === "frameSimulation") {
+          result.moveSearchEngine = 0;
+        } else if (value === "floodFill") {
+          result.moveSearchEngine = 1;
+        } else {
+          throw new Error(
+            "Unknown move search engine (expected 'frameSimulation' or 'floodFill'): " +
+              value
+          );
+        }
+        break;
+
+      case "playoutBudget":
+        if (!requestType.includes("cpp")) {
+          throw new Error(
+            "Parameter 'playoutBudget' does not apply to JS queries."
+          );
+        }
+        if (value === "fixed") {
+          result.playoutBudget = 0;
+        } else if (value === "successiveHalving") {
+          result.playoutBudget = 1;
+        } else if (value === "boundPruning") {
+          result.playoutBudget = 2;
+        } else {
+          throw new Error(
+            "Unknown playout budget (expected 'fixed', 'successiveHalving' or 'boundPruning'): " +
+              value
+          );
+        }
+        break;
+
       // These properties are pretty advanced, if you're using them you should know what you're doing
       case "existingXOffset":
         result.existingXOffset = parseInt(value);
@@ -258,5 +298,5 @@ export function getCppEncodedInputString(
   const curPieceIndex = pieceLookup.indexOf(searchState.currentPieceId);
   const nextPieceIndex = pieceLookup.indexOf(searchState.nextPieceId);
   // Includes the final | character at the end due to how the string is parsed (cpp doesn't have an easy split method rip)
-  return `${boardStr}|${searchState.level}|${searchState.lines}|${curPieceIndex}|${nextPieceIndex}|${urlArgs.inputFrameTimeline}|${urlArgs.playoutCount}|${urlArgs.playoutLength}|${urlArgs.pruningBreadth}|`;
+  return `${boardStr}|${searchState.level}|${searchState.lines}|${curPieceIndex}|${nextPieceIndex}|${urlArgs.inputFrameTimeline}|${urlArgs.playoutCount}|${urlArgs.playoutLength}|${urlArgs.pruningBreadth}|${urlArgs.moveSearchEngine}|${urlArgs.playoutBudget}|`;
 }
@@ -1,25 +1,27 @@
 var fs = require("fs");
 
-/** Compile each group of 8 results into a long long */
-function generateCppBase7Ranks() {
+/**
+ * Compile the results into a binary ranks file, with one byte per surface.
+ * See surface_ranks.cpp for the format.
+ */
+function generateBase7RanksFile() {
   let ranks_NoNextBox_NoBars = fs.readFileSync(
     "docs/condensed_NoNextBox_NoBars.txt",
     "utf8"
   );
 
-  const FILENAME = "docs/ranks_base_7.cpp";
+  const FILENAME = "docs/ranks_base_7.bin";
+  const HEADER_SIZE = 16;
 
-  fs.writeFileSync(
-    FILENAME,
-    "const unsigned long long surfaceRanksChunked[] = {\n  "
-  );
-  let countRead = 0;
-  let accum = BigInt(0);
   let lastIndex = Math.pow(7, 8);
-  // let lastIndex = 100;
+  const fileBytes = Buffer.alloc(HEADER_SIZE + lastIndex);
+  fileBytes.write("SRRANKS7", 0, "ascii");
+  fileBytes.writeUInt32LE(lastIndex, 8);
+  fileBytes.writeUInt32LE(0, 12);
+
   for (let i = 0; i < lastIndex; i++) {
-    if (countRead % 100000 == 0) {
-      console.log(countRead / 1000000);
+    if (i % 100000 == 0) {
+      console.log(i / 1000000);
     }
 
     // Convert base 7 index to base 9
@@ -35,20 +37,11 @@ function generateCppBase7Ranks() {
     const curNum = parseInt(chunk, 36) / 10 - 1;
     const scaledTo255 = Math.round((curNum / 33.8) * 255); // Originally ranges from 1 - 34.8, now ranges 0 to 255
 
-    accum = accum * BigInt(256);
-    accum += BigInt(scaledTo255);
-    if (countRead % 8 === 7) {
-      fs.appendFileSync(FILENAME, "0x" + accum.toString(16) + ",");
-      accum = BigInt(0);
-    }
-    if (countRead % 800 === 799) {
-      fs.appendFileSync(FILENAME, "\n  ");
-    }
-    countRead++;
+    fileBytes[HEADER_SIZE + i] = scaledTo255;
   }
 
   console.log("finishing");
-  fs.appendFileSync(FILENAME, "\n};");
+  fs.writeFileSync(FILENAME, fileBytes);
 }
 
 // function convertToCFormat() {
@@ -153,4 +146,4 @@ function generateCppBase7Ranks() {
 //   });
 // }
 
-generateCppBase7Ranks();
+generateBase7RanksFile();
@@ -37,6 +37,8 @@ interface UrlArguments {
   playoutCount: number; // Only used in C++ queries
   playoutLength: number; // Only used in C++ queries
   pruningBreadth: number; // Only used in C++ queries
+  moveSearchEngine: number; // Only used in C++ queries. 0 = frame simulation, 1 = flood fill
+  playoutBudget: number; // Only used in C++ queries. 0 = same playout count for every candidate, 1 = successive halving, 2 = bound pruning (move requests only)
   arrWasReset?: boolean;
   existingXOffset?: number;
   existingYOffset?: number;
@@ -4,9 +4,13 @@ import {
   CPP_LIVEGAME_PLAYOUT_COUNT,
   CPP_LIVEGAME_PLAYOUT_LENGTH,
   CPP_LIVEGAME_PRUNING_BREADTH,
+  getCppThreadCount,
 } from "./params";
 const cModule = require("../../../build/Release/cRabbit");
 
+// There's a worker for each piece, and they all compute at once, so this is kept separate from the main process's count
+cModule.setThreadCount(getCppThreadCount("CPP_WORKER_THREAD_COUNT"));
+
 console.timeEnd("loading");
 process.send({ type: "ready" }); // Let the main process know that it's loaded the ranks file
 
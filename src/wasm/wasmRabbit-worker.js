@@ -19,6 +19,9 @@ const SR_PIECES_INDEXES = {
 
 const DELIM = "|";
 
+// Preloaded into the wasm file system when the module is compiled (see emscriptem.md)
+const SURFACE_RANKS_PATH = "/ranks_base_7.bin";
+
 function getStackRabbitArgString(args) {
   // Make playouts exhaustive for small lengths
   const playoutCount =
@@ -90,6 +93,11 @@ self.onmessage = () => {
 
 function workerInit() {
   console.log("workerInit");
+  const ranksError = Module.loadSurfaceRanks(SURFACE_RANKS_PATH);
+  if (ranksError) {
+    // The engine still works without the ranks, but rates surfaces on flatness alone
+    console.error("Couldn't load surface ranks:", ranksError);
+  }
   postMessage({ type: "init" });
   self.onmessage = handle_message;
 }